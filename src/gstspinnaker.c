@@ -30,6 +30,11 @@
  * |[
  * gst-launch-1.0 spinnakersrc ! videoconvert ! autovideosink
  * ]|
+ * Unless downstream caps ask for a frame rate, the camera runs at the
+ * fastest rate it can reach with its exposure and frame size.
+ * |[
+ * gst-launch-1.0 spinnakersrc ! video/x-raw,framerate=30/1 ! videoconvert ! autovideosink
+ * ]|
  * </refsect2>
  */
 
@@ -40,6 +45,9 @@
 #include <unistd.h> // for usleep
 #include <string.h> // for memcpy
 #include <math.h>  // for pow
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -49,6 +57,10 @@
 #include <gst/video/video.h>
 
 #include "gstspinnaker.h"
+#include "gstspinnakermeta.h"
+#include "gstspinnakerraw.h"
+#include "gstspinnakerrawsink.h"
+#include "gstspinnakerrawsrc.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_spinnaker_src_debug);
 #define GST_CAT_DEFAULT gst_spinnaker_src_debug
@@ -61,10 +73,43 @@ static void gst_spinnaker_src_get_property (GObject * object,
 static void gst_spinnaker_src_dispose (GObject * object);
 static void gst_spinnaker_src_finalize (GObject * object);
 
+static GstStateChangeReturn gst_spinnaker_src_change_state (GstElement * element,
+		GstStateChange transition);
+
 static gboolean gst_spinnaker_src_start (GstBaseSrc * src);
 static gboolean gst_spinnaker_src_stop (GstBaseSrc * src);
 static GstCaps *gst_spinnaker_src_get_caps (GstBaseSrc * src, GstCaps * filter);
+static GstCaps *gst_spinnaker_src_fixate (GstBaseSrc * src, GstCaps * caps);
 static gboolean gst_spinnaker_src_set_caps (GstBaseSrc * src, GstCaps * caps);
+static gboolean gst_spinnaker_src_unlock (GstBaseSrc * src);
+static gboolean gst_spinnaker_src_unlock_stop (GstBaseSrc * src);
+static gboolean gst_spinnaker_src_event (GstBaseSrc * src, GstEvent * event);
+static gboolean gst_spinnaker_src_decide_allocation (GstBaseSrc * src, GstQuery * query);
+static gboolean gst_spinnaker_src_query (GstBaseSrc * src, GstQuery * query);
+static GstPad *gst_spinnaker_src_request_new_pad (GstElement * element,
+		GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_spinnaker_src_release_pad (GstElement * element, GstPad * pad);
+static GstPadProbeReturn gst_spinnaker_src_src_probe (GstPad * pad,
+		GstPadProbeInfo * info, gpointer user_data);
+
+static void gst_spinnaker_src_free_ring (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_hdr_clear (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_setup_preview (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_setup_flat (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_setup_average (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_setup_streaming_thread (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_setup_orientation (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap);
+static void gst_spinnaker_src_parse_rois (GstSpinnakerSrc * src, const gchar * str);
+static void gst_spinnaker_src_setup_roi_pad (GstSpinnakerSrc * src, GstSpinnakerAuxPad * aux);
+static void gst_spinnaker_src_aux_unref (GstSpinnakerAuxPad * aux);
+static GList *gst_spinnaker_src_get_roi_pads (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_trigger (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_arm (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_capture_dark (GstSpinnakerSrc * src, guint n_frames);
+static void gst_spinnaker_src_capture_flat (GstSpinnakerSrc * src, guint n_frames);
+static void gst_spinnaker_src_flat_free (GstSpinnakerSrc * src);
+static void gst_spinnaker_src_average_free (GstSpinnakerSrc * src);
+static guint gst_spinnaker_src_average_block (GstSpinnakerSrc * src);
 
 #ifdef OVERRIDE_CREATE
 	static GstFlowReturn gst_spinnaker_src_create (GstPushSrc * src, GstBuffer ** buf);
@@ -79,17 +124,78 @@ enum
 {
 	PROP_0,
 	PROP_CAMERA,
+	PROP_SERIAL,
+	PROP_DEVICE_USER_ID,
 	PROP_WIDTH,
-	PROP_HEIGHT
+	PROP_HEIGHT,
+	PROP_THROUGHPUT_LIMIT,
+	PROP_THROUGHPUT_AUTO,
+	PROP_THROUGHPUT_BUDGET,
+	PROP_EXPOSURE,
+	PROP_GAIN,
+	PROP_AUTO_EXPOSURE,
+	PROP_AUTO_GAIN,
+	PROP_AE_TARGET,
+	PROP_AE_INTERVAL,
+	PROP_AE_DAMPING,
+	PROP_AE_MAX_GAIN,
+	PROP_STATISTICS,
+	PROP_FOCUS_METRIC,
+	PROP_PRETRIGGER_FRAMES,
+	PROP_PRETRIGGER_TIME,
+	PROP_PRETRIGGER_PREVIEW,
+	PROP_HDR_FRAMES,
+	PROP_HDR_RATIO,
+	PROP_PREVIEW_SCALE,
+	PROP_PREVIEW_RATE,
+	PROP_ROIS,
+	PROP_MEMORY,
+	PROP_BLACKLEVEL,
+	PROP_DARK_LOCATION,
+	PROP_FLAT_LOCATION,
+	PROP_HFLIP,
+	PROP_VFLIP,
+	PROP_ROTATION,
+	PROP_AVERAGE_FRAMES,
+	PROP_AVERAGE_MODE,
+	PROP_CONVERSION_THREADS,
+	PROP_CPU_AFFINITY,
+	PROP_SCHEDULING,
+	PROP_SCHEDULING_PRIORITY,
+	PROP_GATE_MODE,
+	PROP_GATE_THRESHOLD,
+	PROP_GATE_KEEPALIVE,
+	PROP_FRAMES_SUPPRESSED,
+	PROP_RECONNECT,
+	PROP_RECONNECT_TIMEOUT,
+	PROP_RECONNECTS,
+	PROP_OUTAGE_TOTAL,
+	PROP_OUTAGE_LAST
+};
+
+enum
+{
+	SIGNAL_TRIGGER,
+	SIGNAL_ARM,
+	SIGNAL_CAPTURE_DARK,
+	SIGNAL_CAPTURE_FLAT,
+	LAST_SIGNAL
 };
 
+static guint gst_spinnaker_src_signals[LAST_SIGNAL] = { 0 };
+
+// caps naming the camera clock in GstReferenceTimestampMeta
+static GstCaps *hw_timestamp_caps = NULL;
+
 #define	FLYCAP_UPDATE_LOCAL  FALSE
 #define	FLYCAP_UPDATE_CAMERA TRUE
 
 #define DEFAULT_PROP_CAMERA	           0
+#define DEFAULT_PROP_SERIAL             NULL
+#define DEFAULT_PROP_DEVICE_USER_ID     NULL
 #define DEFAULT_PROP_EXPOSURE           40.0
-#define DEFAULT_PROP_GAIN               1
-#define DEFAULT_PROP_BLACKLEVEL         15
+#define DEFAULT_PROP_GAIN               0.0
+#define DEFAULT_PROP_BLACKLEVEL         0
 #define DEFAULT_PROP_RGAIN              425
 #define DEFAULT_PROP_BGAIN              727
 #define DEFAULT_PROP_BINNING            1
@@ -109,8 +215,57 @@ enum
 #define DEFAULT_PROP_GAMMA			    1.5
 #define DEFAULT_PROP_WIDTH 				640
 #define DEFAULT_PROP_HEIGHT			    512
+#define DEFAULT_PROP_THROUGHPUT_LIMIT   0    // leave the camera's own setting alone
+#define DEFAULT_PROP_THROUGHPUT_AUTO    FALSE
+#define DEFAULT_PROP_THROUGHPUT_BUDGET  380000000   // bytes/s, a realistic figure for one USB3 controller
+#define DEFAULT_RAW_BYTES_PER_PIXEL     2    // ConfigureCustomImageSettings selects Mono14
+#define DEFAULT_PROP_AUTO_EXPOSURE      FALSE
+#define DEFAULT_PROP_AUTO_GAIN          TRUE
+#define DEFAULT_PROP_AE_TARGET          110
+#define DEFAULT_PROP_AE_INTERVAL        2
+#define DEFAULT_PROP_AE_DAMPING         0.5
+#define DEFAULT_PROP_AE_MAX_GAIN        18.0
+#define DEFAULT_PROP_STATISTICS         FALSE
+#define DEFAULT_PROP_FOCUS_METRIC       FALSE
+#define DEFAULT_PROP_PRETRIGGER_FRAMES  0
+#define DEFAULT_PROP_PRETRIGGER_TIME    0
+#define DEFAULT_PROP_PRETRIGGER_PREVIEW 0
+#define DEFAULT_PROP_HDR_FRAMES         0
+#define DEFAULT_PROP_HDR_RATIO          4.0
+#define DEFAULT_PROP_PREVIEW_SCALE      4
+#define DEFAULT_PROP_PREVIEW_RATE       5.0
+#define DEFAULT_PROP_ROIS               NULL
+#define DEFAULT_PROP_MEMORY             GST_SPINNAKER_MEMORY_SYSTEM
+#define DEFAULT_PROP_DARK_LOCATION      NULL
+#define DEFAULT_PROP_FLAT_LOCATION      NULL
+#define DEFAULT_PROP_HFLIP              FALSE
+#define DEFAULT_PROP_VFLIP              FALSE
+#define DEFAULT_PROP_ROTATION           GST_SPINNAKER_ROTATION_NONE
+#define DEFAULT_PROP_AVERAGE_FRAMES     0
+#define DEFAULT_PROP_AVERAGE_MODE       GST_SPINNAKER_AVERAGE_BLOCK
+#define DEFAULT_PROP_CONVERSION_THREADS 1
+#define DEFAULT_PROP_CPU_AFFINITY       NULL
+#define DEFAULT_PROP_SCHEDULING         GST_SPINNAKER_SCHEDULING_NORMAL
+#define DEFAULT_PROP_SCHEDULING_PRIORITY 10
+#define DEFAULT_PROP_GATE_MODE          GST_SPINNAKER_GATE_OFF
+#define DEFAULT_PROP_GATE_THRESHOLD     3.0
+#define DEFAULT_PROP_GATE_KEEPALIVE     1000
+#define DEFAULT_PROP_RECONNECT          GST_SPINNAKER_RECONNECT_OFF
+#define DEFAULT_PROP_RECONNECT_TIMEOUT  0
+
+#define GRAB_TIMEOUT_MS                 100  // so create() notices unlock() in time
+#define PRETRIGGER_EVENT_NAME           "spinnaker-trigger"
 
 #define DEFAULT_GST_VIDEO_FORMAT GST_VIDEO_FORMAT_GRAY8
+#define HDR_GST_VIDEO_FORMAT     GST_VIDEO_FORMAT_GRAY16_LE
+#define MAX_WORKER_THREADS       16
+#define MAX_CPUS                 1024        // CPU_SETSIZE
+#define DEFAULT_STREAM_BUFFERS   10   // the SDK's default stream buffer count
+#define LATENCY_HYSTERESIS       10   // percent change before a new latency message
+#define MIN_FD_BUFFERS           4
+#define BAND_THREAD_PIXELS       (1 << 20)   // split frames in bands across the workers from this size
+#define MAX_CALIBRATION_FRAMES   65535       // sums of 16 bit pixels still fit 32 bits
+#define ORIENT_BAND              32          // rows oriented at once, while still in cache
 // Put matching type text in the pad template below
 
 // pad template
@@ -118,10 +273,26 @@ static GstStaticPadTemplate gst_spinnaker_src_template =
 		GST_STATIC_PAD_TEMPLATE ("src",
 				GST_PAD_SRC,
 				GST_PAD_ALWAYS,
+				GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE
+						("{ GRAY8, GRAY16_LE }"))
+		);
+
+static GstStaticPadTemplate gst_spinnaker_src_preview_template =
+		GST_STATIC_PAD_TEMPLATE ("preview",
+				GST_PAD_SRC,
+				GST_PAD_REQUEST,
 				GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE
 						("{ GRAY8 }"))
 		);
 
+static GstStaticPadTemplate gst_spinnaker_src_roi_template =
+		GST_STATIC_PAD_TEMPLATE ("roi_%u",
+				GST_PAD_SRC,
+				GST_PAD_REQUEST,
+				GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE
+						("{ GRAY8, GRAY16_LE }"))
+		);
+
 #define EXEANDCHECK(function) \
 {\
 	spinError Ret = function;\
@@ -474,6 +645,523 @@ spinError ConfigureCustomImageSettings(spinNodeMapHandle hNodeMap)
     return err;
 }
 
+// Sets an integer node, clamping the value to the node's range and increment.
+// The value actually written is returned in applied (if not NULL).
+static gboolean
+gst_spinnaker_src_set_int_node (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap,
+		const char *name, int64_t value, int64_t *applied)
+{
+	spinNodeHandle hNode = NULL;
+	int64_t min = 0, max = 0, inc = 1;
+
+	if (spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!IsAvailableAndWritable(hNode, (char *) name)) {
+		GST_DEBUG_OBJECT (src, "node %s is not writable", name);
+		return FALSE;
+	}
+
+	EXEANDCHECK(spinIntegerGetMin(hNode, &min));
+	EXEANDCHECK(spinIntegerGetMax(hNode, &max));
+	EXEANDCHECK(spinIntegerGetInc(hNode, &inc));
+	value = CLAMP(value, min, max);
+	if (inc > 1)
+		value = min + ((value - min) / inc) * inc;
+
+	EXEANDCHECK(spinIntegerSetValue(hNode, value));
+	GST_DEBUG_OBJECT (src, "%s set to %" G_GINT64_FORMAT, name, (gint64) value);
+	if (applied)
+		*applied = value;
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+// Reads an integer node, returns FALSE if it is not available on this camera
+static gboolean
+gst_spinnaker_src_get_int_node (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap,
+		const char *name, int64_t *value)
+{
+	spinNodeHandle hNode = NULL;
+
+	if (spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!IsAvailableAndReadable(hNode, (char *) name))
+		return FALSE;
+
+	EXEANDCHECK(spinIntegerGetValue(hNode, value));
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+// Sets a float node, clamped to the node's range
+static gboolean
+gst_spinnaker_src_set_float_node (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap,
+		const char *name, double value, double *applied)
+{
+	spinNodeHandle hNode = NULL;
+	double min = 0.0, max = 0.0;
+
+	if (spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!IsAvailableAndWritable(hNode, (char *) name)) {
+		GST_DEBUG_OBJECT (src, "node %s is not writable", name);
+		return FALSE;
+	}
+
+	EXEANDCHECK(spinFloatGetMin(hNode, &min));
+	EXEANDCHECK(spinFloatGetMax(hNode, &max));
+	value = CLAMP(value, min, max);
+
+	EXEANDCHECK(spinFloatSetValue(hNode, value));
+	GST_DEBUG_OBJECT (src, "%s set to %f", name, value);
+	if (applied)
+		*applied = value;
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+// Reads the current value and range of a float node, any of the outputs may be NULL
+static gboolean
+gst_spinnaker_src_get_float_node (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap,
+		const char *name, double *value, double *min, double *max)
+{
+	spinNodeHandle hNode = NULL;
+
+	if (spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!IsAvailableAndReadable(hNode, (char *) name))
+		return FALSE;
+
+	if (value)
+		EXEANDCHECK(spinFloatGetValue(hNode, value));
+	if (min)
+		EXEANDCHECK(spinFloatGetMin(hNode, min));
+	if (max)
+		EXEANDCHECK(spinFloatGetMax(hNode, max));
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+static gboolean
+gst_spinnaker_src_set_bool_node (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap,
+		const char *name, gboolean value)
+{
+	spinNodeHandle hNode = NULL;
+
+	if (spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!IsAvailableAndWritable(hNode, (char *) name))
+		return FALSE;
+
+	EXEANDCHECK(spinBooleanSetValue(hNode, value ? True : False));
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+// Sets an enumeration node to the entry with the given symbolic name
+static gboolean
+gst_spinnaker_src_set_enum_node (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap,
+		const char *name, const char *entry)
+{
+	spinNodeHandle hNode = NULL;
+	spinNodeHandle hEntry = NULL;
+	int64_t value = 0;
+
+	if (spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!IsAvailableAndWritable(hNode, (char *) name))
+		return FALSE;
+
+	EXEANDCHECK(spinEnumerationGetEntryByName(hNode, entry, &hEntry));
+	if (!IsAvailableAndReadable(hEntry, (char *) entry))
+		return FALSE;
+	EXEANDCHECK(spinEnumerationEntryGetIntValue(hEntry, &value));
+	EXEANDCHECK(spinEnumerationSetIntValue(hNode, value));
+	GST_DEBUG_OBJECT (src, "%s set to %s", name, entry);
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+// Executes a command node
+static gboolean
+gst_spinnaker_src_execute_node (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap,
+		const char *name)
+{
+	spinNodeHandle hNode = NULL;
+
+	if (spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!IsAvailableAndWritable(hNode, (char *) name))
+		return FALSE;
+
+	EXEANDCHECK(spinCommandExecute(hNode));
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+// Programs the sequencer to cycle through hdr_frames sets, each one hdr_ratio
+// times longer than the last and advancing to the next on every frame. The
+// camera must not be acquiring. Frames are tagged with their set through
+// chunk data when the camera supports it.
+static gboolean
+gst_spinnaker_src_setup_sequencer (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap)
+{
+	double exposure, applied;
+	guint i;
+
+	// a previous run may have left the sequencer on
+	gst_spinnaker_src_set_enum_node (src, hNodeMap, "SequencerMode", "Off");
+	src->hdr_active = FALSE;
+	if (src->hdr_frames < 2)
+		return TRUE;
+
+	gst_spinnaker_src_set_enum_node (src, hNodeMap, "ExposureAuto", "Off");
+	gst_spinnaker_src_set_enum_node (src, hNodeMap, "GainAuto", "Off");
+	if (!gst_spinnaker_src_set_enum_node (src, hNodeMap, "SequencerConfigurationMode", "On")) {
+		GST_ERROR_OBJECT (src, "camera has no sequencer, HDR bracketing is not possible");
+		return FALSE;
+	}
+
+	exposure = src->exposure * 1000.0;
+	for (i = 0; i < src->hdr_frames; i++) {
+		if (!gst_spinnaker_src_set_int_node (src, hNodeMap, "SequencerSetSelector", i, NULL) ||
+				!gst_spinnaker_src_set_float_node (src, hNodeMap, "ExposureTime", exposure, &applied))
+			goto fail;
+		src->hdr_exposure[i] = applied;
+		gst_spinnaker_src_set_float_node (src, hNodeMap, "Gain", src->gain, NULL);
+		gst_spinnaker_src_set_int_node (src, hNodeMap, "SequencerPathSelector", 0, NULL);
+		if (!gst_spinnaker_src_set_enum_node (src, hNodeMap, "SequencerTriggerSource", "FrameStart") ||
+				!gst_spinnaker_src_set_int_node (src, hNodeMap, "SequencerSetNext", (i + 1) % src->hdr_frames, NULL) ||
+				!gst_spinnaker_src_execute_node (src, hNodeMap, "SequencerSetSave"))
+			goto fail;
+		GST_INFO_OBJECT (src, "sequencer set %u: exposure %f us", i, applied);
+		exposure *= src->hdr_ratio;
+	}
+
+	if (!gst_spinnaker_src_set_int_node (src, hNodeMap, "SequencerSetStart", 0, NULL) ||
+			!gst_spinnaker_src_set_enum_node (src, hNodeMap, "SequencerConfigurationMode", "Off") ||
+			!gst_spinnaker_src_set_enum_node (src, hNodeMap, "SequencerMode", "On"))
+		goto fail;
+
+	// without the set index in the chunk data, frames are grouped by arrival order
+	src->hdr_chunk = gst_spinnaker_src_set_bool_node (src, hNodeMap, "ChunkModeActive", TRUE) &&
+			gst_spinnaker_src_set_enum_node (src, hNodeMap, "ChunkSelector", "SequencerSetActive") &&
+			gst_spinnaker_src_set_bool_node (src, hNodeMap, "ChunkEnable", TRUE);
+	if (!src->hdr_chunk)
+		GST_WARNING_OBJECT (src, "no sequencer set chunk, a dropped frame will misalign brackets");
+
+	gst_spinnaker_hdr_set_exposures (&src->hdr_merge, src->hdr_exposure, src->hdr_frames);
+	src->hdr_active = TRUE;
+	return TRUE;
+
+	fail:
+	GST_ERROR_OBJECT (src, "failed to program the sequencer");
+	gst_spinnaker_src_set_enum_node (src, hNodeMap, "SequencerConfigurationMode", "Off");
+	return FALSE;
+}
+
+// Turns frame rate control on or off, under either name of the node
+static gboolean
+gst_spinnaker_src_enable_framerate (GstSpinnakerSrc * src, gboolean enable)
+{
+	return gst_spinnaker_src_set_bool_node (src, src->hNodeMap, "AcquisitionFrameRateEnable", enable) ||
+			gst_spinnaker_src_set_bool_node (src, src->hNodeMap, "AcquisitionFrameRateEnabled", enable);
+}
+
+// Reads the frame rates the camera can reach with its current exposure, ROI
+// and pixel format into fps_min and fps_max; AcquisitionFrameRate's maximum
+// already accounts for those. The range is only meaningful while frame rate
+// control is enabled, so this leaves it enabled. Only called where the
+// nodemap is ours to write, caps queries use what was read last.
+static gboolean
+gst_spinnaker_src_probe_framerate_range (GstSpinnakerSrc * src)
+{
+	gdouble min = 0.0, max = 0.0;
+
+	if (src->hNodeMap == NULL)
+		return FALSE;
+
+	gst_spinnaker_src_enable_framerate (src, TRUE);
+	if (!gst_spinnaker_src_get_float_node (src, src->hNodeMap, "AcquisitionFrameRate", NULL, &min, &max) ||
+			max <= 0.0) {
+		src->fps_min = src->fps_max = 0.0;
+		return FALSE;
+	}
+	src->fps_min = min;
+	src->fps_max = max;
+	return TRUE;
+}
+
+// Writes exposure and gain that were changed by a property to the camera.
+// Called from the streaming thread so the nodemap is only used by one thread.
+static void
+gst_spinnaker_src_apply_exposure (GstSpinnakerSrc * src)
+{
+	double applied;
+
+	if (src->hNodeMap == NULL)
+		return;
+
+	if (src->exposure_just_changed) {
+		src->exposure_just_changed = FALSE;
+		gst_spinnaker_src_set_enum_node (src, src->hNodeMap, "ExposureAuto", "Off");
+		if (gst_spinnaker_src_set_float_node (src, src->hNodeMap, "ExposureTime",
+					src->exposure * 1000.0, &applied))
+			src->exposure = applied / 1000.0;
+		src->latency_dirty = TRUE;
+	}
+
+	if (src->gain_just_changed) {
+		src->gain_just_changed = FALSE;
+		gst_spinnaker_src_set_enum_node (src, src->hNodeMap, "GainAuto", "Off");
+		if (gst_spinnaker_src_set_float_node (src, src->hNodeMap, "Gain", src->gain, &applied))
+			src->gain = applied;
+	}
+}
+
+// Adds one row of 8 bit pixels to the frame statistics. Four partial
+// histograms are used in turn so that runs of equal pixels, which are common
+// in flat images, don't serialise on a single counter.
+static inline void
+gst_spinnaker_src_row_stats (GstSpinnakerFrameStats *stats, const guint8 *row, unsigned int width)
+{
+	guint32 *h0 = stats->lanes[0], *h1 = stats->lanes[1];
+	guint32 *h2 = stats->lanes[2], *h3 = stats->lanes[3];
+	unsigned int x = 0;
+
+	for (; x + 4 <= width; x += 4) {
+		h0[row[x]]++;
+		h1[row[x + 1]]++;
+		h2[row[x + 2]]++;
+		h3[row[x + 3]]++;
+	}
+	for (; x < width; x++)
+		h0[row[x]]++;
+	stats->n_pixels += width;
+}
+
+// Gradient energy of one row against the row above it, a cheap focus measure
+static inline guint64
+gst_spinnaker_src_row_focus (const guint8 *row, const guint8 *prev, unsigned int width)
+{
+	guint64 energy = 0;
+	unsigned int x = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128 ();
+	__m128i acc = _mm_setzero_si128 ();
+	guint32 lanes[4];
+
+	// each 32 bit lane gains at most 4 * 2 * 255^2 per step, fine for any sensor width
+	for (; x + 17 <= width; x += 16) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *) (row + x));
+		__m128i right = _mm_loadu_si128 ((const __m128i *) (row + x + 1));
+		__m128i up = _mm_loadu_si128 ((const __m128i *) (prev + x));
+		__m128i plo = _mm_unpacklo_epi8 (p, zero);
+		__m128i phi = _mm_unpackhi_epi8 (p, zero);
+		__m128i dxlo = _mm_sub_epi16 (_mm_unpacklo_epi8 (right, zero), plo);
+		__m128i dxhi = _mm_sub_epi16 (_mm_unpackhi_epi8 (right, zero), phi);
+		__m128i dylo = _mm_sub_epi16 (plo, _mm_unpacklo_epi8 (up, zero));
+		__m128i dyhi = _mm_sub_epi16 (phi, _mm_unpackhi_epi8 (up, zero));
+		acc = _mm_add_epi32 (acc, _mm_madd_epi16 (dxlo, dxlo));
+		acc = _mm_add_epi32 (acc, _mm_madd_epi16 (dxhi, dxhi));
+		acc = _mm_add_epi32 (acc, _mm_madd_epi16 (dylo, dylo));
+		acc = _mm_add_epi32 (acc, _mm_madd_epi16 (dyhi, dyhi));
+	}
+	_mm_storeu_si128 ((__m128i *) lanes, acc);
+	energy = (guint64) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+	for (; x + 1 < width; x++) {
+		int dx = row[x + 1] - row[x];
+		int dy = row[x] - prev[x];
+		energy += dx * dx + dy * dy;
+	}
+	return energy;
+}
+
+// Merges the partial histograms and derives the summary values
+static void
+gst_spinnaker_src_finish_stats (GstSpinnakerFrameStats *stats)
+{
+	int i;
+
+	stats->sum = 0;
+	stats->min = 255;
+	stats->max = 0;
+	for (i = 0; i < 256; i++) {
+		guint32 n = stats->lanes[0][i] + stats->lanes[1][i] + stats->lanes[2][i] + stats->lanes[3][i];
+		stats->histogram[i] = n;
+		stats->sum += (guint64) i * n;
+		if (n) {
+			stats->min = MIN(stats->min, i);
+			stats->max = i;
+		}
+	}
+	stats->saturated = stats->histogram[255];
+	if (stats->n_pixels == 0)
+		stats->min = 0;
+}
+
+static void
+gst_spinnaker_src_attach_stats (GstSpinnakerSrc * src, GstBuffer * buf)
+{
+	GstSpinnakerFrameStats *stats = &src->stats;
+	GstSpinnakerStatsMeta *meta = gst_buffer_add_spinnaker_stats_meta (buf);
+
+	memcpy (meta->histogram, stats->histogram, sizeof (meta->histogram));
+	meta->n_pixels = stats->n_pixels;
+	meta->min = stats->min;
+	meta->max = stats->max;
+	meta->mean = stats->n_pixels ? (gdouble) stats->sum / stats->n_pixels : 0.0;
+	meta->saturated = stats->saturated;
+	meta->focus = stats->focus_pixels ? (gdouble) stats->focus_sum / stats->focus_pixels : -1.0;
+}
+
+// Host-side auto exposure. The camera's own loop reacts too slowly for sudden
+// lighting changes, so steer exposure (and gain once the exposure is as long
+// as the frame period allows) towards ae-target from the histogram gathered
+// during the copy. Only a damped part of the correction is applied per update.
+static void
+gst_spinnaker_src_auto_exposure (GstSpinnakerSrc * src)
+{
+	GstSpinnakerFrameStats *stats = &src->stats;
+	gdouble mean, saturated, ratio, ev, exposure, gain, max_exposure, max_gain;
+
+	if (stats->n_pixels == 0 || src->hNodeMap == NULL)
+		return;
+
+	if (++src->ae_frame_count < src->ae_interval)
+		return;
+	src->ae_frame_count = 0;
+
+	mean = (gdouble) stats->sum / stats->n_pixels;
+	saturated = (gdouble) stats->saturated / stats->n_pixels;
+
+	ratio = src->ae_target / MAX(mean, 1.0);
+	// the mean says nothing about how far over the top clipped pixels are
+	if (saturated > 0.02)
+		ratio = MIN(ratio, 0.7);
+	ratio = CLAMP(ratio, 0.25, 4.0);
+	if (fabs(ratio - 1.0) < 0.03)
+		return;
+	ratio = pow(ratio, src->ae_damping);
+
+	// exposure in ms, limited to the frame period so the frame rate is kept
+	max_exposure = 1000.0 / MAX(src->framerate, 1.0);
+	max_gain = src->auto_gain ? src->ae_max_gain : src->gain;
+	ev = src->exposure * pow(10.0, src->gain / 20.0) * ratio;
+	exposure = MIN(ev, max_exposure);
+	gain = src->auto_gain ? 20.0 * log10(ev / exposure) : src->gain;
+	gain = CLAMP(gain, 0.0, max_gain);
+
+	GST_LOG_OBJECT (src, "AE: mean %.1f, saturated %.3f, exposure %.3f -> %.3f ms, gain %.2f -> %.2f dB",
+			mean, saturated, src->exposure, exposure, src->gain, gain);
+
+	if (exposure != src->exposure) {
+		src->exposure = exposure;
+		src->exposure_just_changed = TRUE;
+	}
+	if (gain != src->gain) {
+		src->gain = gain;
+		src->gain_just_changed = TRUE;
+	}
+	gst_spinnaker_src_apply_exposure (src);
+}
+
+// Cameras that are at least READY in this process, used to share the
+// bandwidth of a host controller between them. See throughput-auto.
+G_LOCK_DEFINE_STATIC (link_registry);
+static GList *link_registry = NULL;
+
+// Flags the cameras sharing throughput-budget to apply their new share.
+// Each does so from its own streaming thread, which owns its nodemap.
+static void
+gst_spinnaker_src_rebalance_links (void)
+{
+	GList *l;
+
+	G_LOCK (link_registry);
+	for (l = link_registry; l != NULL; l = l->next)
+		g_atomic_int_set (&GST_SPINNAKER_SRC (l->data)->link_dirty, 1);
+	G_UNLOCK (link_registry);
+}
+
+// Records the bandwidth the camera needs at the negotiated size and capture
+// rate, in bytes/s, and has every camera work out its share again
+static void
+gst_spinnaker_src_set_link_demand (GstSpinnakerSrc * src, gdouble demand)
+{
+	G_LOCK (link_registry);
+	src->link_demand = demand;
+	G_UNLOCK (link_registry);
+	gst_spinnaker_src_rebalance_links ();
+}
+
+// Works out the throughput limit to program: either the fixed
+// throughput-limit, or this camera's share of throughput-budget. Cameras
+// that haven't negotiated yet get an even share, the others split the rest
+// weighted by what each needs. Returns 0 to leave the camera alone.
+static gint64
+gst_spinnaker_src_link_limit (GstSpinnakerSrc * src)
+{
+	gdouble total = 0.0, own;
+	guint n = 0, n_known = 0;
+	GList *l;
+
+	if (!src->throughput_auto)
+		return src->throughput_limit;
+
+	G_LOCK (link_registry);
+	own = src->link_demand;
+	for (l = link_registry; l != NULL; l = l->next) {
+		gdouble demand = GST_SPINNAKER_SRC (l->data)->link_demand;
+
+		n++;
+		if (demand > 0.0) {
+			total += demand;
+			n_known++;
+		}
+	}
+	G_UNLOCK (link_registry);
+
+	if (n == 0)
+		return src->throughput_budget;
+	if (own <= 0.0)
+		return src->throughput_budget / n;
+
+	return (gint64) (src->throughput_budget * ((gdouble) n_known / n) * (own / total));
+}
+
+static void
+gst_spinnaker_src_apply_link_limit (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap)
+{
+	gint64 limit = gst_spinnaker_src_link_limit (src);
+	gdouble demand = src->link_demand;
+	int64_t applied = 0;
+
+	if (limit <= 0 || hNodeMap == NULL)
+		return;
+
+	if (!gst_spinnaker_src_set_int_node (src, hNodeMap, "DeviceLinkThroughputLimit", limit, &applied)) {
+		GST_WARNING_OBJECT (src, "camera does not allow setting DeviceLinkThroughputLimit");
+		return;
+	}
+
+	GST_INFO_OBJECT (src, "link throughput limited to %" G_GINT64_FORMAT " bytes/s (wanted %"
+			G_GINT64_FORMAT ", needs %.0f)", (gint64) applied, limit, demand);
+	if (applied < demand)
+		GST_WARNING_OBJECT (src, "throughput limit is below what the current settings need, "
+				"the camera will lower its frame rate");
+}
+
 
 
 
@@ -496,14 +1184,35 @@ gst_spinnaker_src_class_init (GstSpinnakerSrcClass * klass)
 
 	gst_element_class_add_pad_template (gstelement_class,
 			gst_static_pad_template_get (&gst_spinnaker_src_template));
+	gst_element_class_add_pad_template (gstelement_class,
+			gst_static_pad_template_get (&gst_spinnaker_src_preview_template));
+	gst_element_class_add_pad_template (gstelement_class,
+			gst_static_pad_template_get (&gst_spinnaker_src_roi_template));
 
 	gst_element_class_set_static_metadata (gstelement_class,
 			"Spinnaker Video Source", "Source/Video",
 			"Spinnaker Camera video source", "David Thompson <dave@republicofdave.net>");
 
+	gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_spinnaker_src_change_state);
+	gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR (gst_spinnaker_src_request_new_pad);
+	gstelement_class->release_pad = GST_DEBUG_FUNCPTR (gst_spinnaker_src_release_pad);
+
 	gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_spinnaker_src_start);
 	gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_spinnaker_src_stop);
 	gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_spinnaker_src_get_caps);
+	gstbasesrc_class->fixate = GST_DEBUG_FUNCPTR (gst_spinnaker_src_fixate);
+	gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_spinnaker_src_unlock);
+	gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_spinnaker_src_unlock_stop);
+	gstbasesrc_class->event = GST_DEBUG_FUNCPTR (gst_spinnaker_src_event);
+	gstbasesrc_class->decide_allocation = GST_DEBUG_FUNCPTR (gst_spinnaker_src_decide_allocation);
+	gstbasesrc_class->query = GST_DEBUG_FUNCPTR (gst_spinnaker_src_query);
+
+	klass->trigger = gst_spinnaker_src_trigger;
+	klass->arm = gst_spinnaker_src_arm;
+	klass->capture_dark = gst_spinnaker_src_capture_dark;
+	klass->capture_flat = gst_spinnaker_src_capture_flat;
+
+	hw_timestamp_caps = gst_caps_new_empty_simple (GST_SPINNAKER_HW_TIMESTAMP_CAPS);
 	gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_spinnaker_src_set_caps);
 
 #ifdef OVERRIDE_CREATE
@@ -516,8 +1225,273 @@ gst_spinnaker_src_class_init (GstSpinnakerSrcClass * klass)
 #endif
 	//camera id property
 	g_object_class_install_property (gobject_class, PROP_CAMERA,
-		g_param_spec_int("camera-id", "Camera ID", "Camera ID to open.", 0,7, DEFAULT_PROP_CAMERA,
+		g_param_spec_int("camera-id", "Camera ID", "Camera ID to open. This is an index in the SDK's camera list, whose order may change between boots. Not used if serial or device-user-id is set.", 0,7, DEFAULT_PROP_CAMERA,
 		 (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_SERIAL,
+		g_param_spec_string("serial", "Serial number",
+			"Serial number of the camera to open. The camera is looked up directly, without opening the others.",
+			DEFAULT_PROP_SERIAL,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_DEVICE_USER_ID,
+		g_param_spec_string("device-user-id", "Device user ID",
+			"DeviceUserID of the camera to open, the name stored in the camera. Not used if serial is set.",
+			DEFAULT_PROP_DEVICE_USER_ID,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_EXPOSURE,
+		g_param_spec_float("exposure", "Exposure", "Exposure time in ms, turns the camera's auto exposure off.",
+			0.001, 30000.0, DEFAULT_PROP_EXPOSURE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_GAIN,
+		g_param_spec_float("gain", "Gain", "Gain in dB, turns the camera's auto gain off.",
+			0.0, 48.0, DEFAULT_PROP_GAIN,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_AUTO_EXPOSURE,
+		g_param_spec_boolean("auto-exposure", "Host auto exposure",
+			"Run the auto exposure loop on the host, from statistics gathered while copying each frame.",
+			DEFAULT_PROP_AUTO_EXPOSURE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_AUTO_GAIN,
+		g_param_spec_boolean("auto-gain", "Host auto gain",
+			"Let the auto exposure loop raise the gain once the exposure reaches the frame period.",
+			DEFAULT_PROP_AUTO_GAIN,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_AE_TARGET,
+		g_param_spec_int("ae-target", "AE target", "Mean grey level the auto exposure loop aims for.",
+			1, 254, DEFAULT_PROP_AE_TARGET,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_AE_INTERVAL,
+		g_param_spec_int("ae-interval", "AE interval", "Number of frames between auto exposure updates.",
+			1, 1000, DEFAULT_PROP_AE_INTERVAL,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_AE_DAMPING,
+		g_param_spec_double("ae-damping", "AE damping",
+			"Fraction (in log space) of the exposure correction applied per update, 1 corrects in one step.",
+			0.05, 1.0, DEFAULT_PROP_AE_DAMPING,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_AE_MAX_GAIN,
+		g_param_spec_float("ae-max-gain", "AE maximum gain", "Highest gain in dB the auto exposure loop may use.",
+			0.0, 48.0, DEFAULT_PROP_AE_MAX_GAIN,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_STATISTICS,
+		g_param_spec_boolean("statistics", "Statistics",
+			"Attach a GstSpinnakerStatsMeta (histogram, min/max/mean, saturated pixels) to every buffer.",
+			DEFAULT_PROP_STATISTICS,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_FOCUS_METRIC,
+		g_param_spec_boolean("focus-metric", "Focus metric",
+			"Also compute the gradient energy of each frame for the statistics meta.",
+			DEFAULT_PROP_FOCUS_METRIC,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_PRETRIGGER_FRAMES,
+		g_param_spec_uint("pretrigger-frames", "Pre-trigger frames",
+			"Keep this many frames in a ring and push nothing until triggered, 0 disables pre-trigger recording.",
+			0, 100000, DEFAULT_PROP_PRETRIGGER_FRAMES,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_PRETRIGGER_TIME,
+		g_param_spec_uint("pretrigger-time", "Pre-trigger time",
+			"Keep at least this many ms of frames before a trigger (at the negotiated frame rate).",
+			0, G_MAXINT, DEFAULT_PROP_PRETRIGGER_TIME,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_PRETRIGGER_PREVIEW,
+		g_param_spec_uint("pretrigger-preview", "Pre-trigger preview",
+			"While armed, push every Nth frame as a low rate preview, 0 pushes nothing.",
+			0, G_MAXINT, DEFAULT_PROP_PRETRIGGER_PREVIEW,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_HDR_FRAMES,
+		g_param_spec_uint("hdr-frames", "HDR frames",
+			"Bracket this many exposures with the camera's sequencer and merge them into one GRAY16 frame, fewer than 2 disables HDR. The output rate is the capture rate divided by this.",
+			0, GST_SPINNAKER_HDR_MAX_FRAMES, DEFAULT_PROP_HDR_FRAMES,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_HDR_RATIO,
+		g_param_spec_double("hdr-ratio", "HDR exposure ratio",
+			"Exposure ratio between consecutive frames of an HDR bracket, starting from the exposure property.",
+			1.1, 256.0, DEFAULT_PROP_HDR_RATIO,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_PREVIEW_SCALE,
+		g_param_spec_uint("preview-scale", "Preview scale",
+			"Downscaling factor of the preview pad, each preview pixel is the mean of a scale x scale block.",
+			2, 16, DEFAULT_PROP_PREVIEW_SCALE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_PREVIEW_RATE,
+		g_param_spec_double("preview-rate", "Preview rate",
+			"Maximum frame rate of the preview pad, 0 previews every frame.",
+			0.0, 1000.0, DEFAULT_PROP_PREVIEW_RATE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_ROIS,
+		g_param_spec_string("rois", "Regions of interest",
+			"Regions pushed on the roi_%u request pads, as \"x,y,width,height;...\". roi_N carries the Nth region as a view of the full frame, without copying.",
+			DEFAULT_PROP_ROIS,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_MEMORY,
+		g_param_spec_enum("memory", "Memory",
+			"Memory frames are pushed in. memfd and dmabuf frames are backed by a file descriptor that unixfdsink or a dmabuf importer can pass on without copying the pixels again. dmabuf falls back to memfd when there is no DMABuf heap.",
+			GST_TYPE_SPINNAKER_MEMORY, DEFAULT_PROP_MEMORY,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_BLACKLEVEL,
+		g_param_spec_int("blacklevel", "Black level",
+			"Offset subtracted from every pixel after the dark map, in 8 bit output levels.",
+			0, 255, DEFAULT_PROP_BLACKLEVEL,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_DARK_LOCATION,
+		g_param_spec_string("dark-location", "Dark map",
+			"Binary PGM with the dark frame subtracted from every frame. A map captured with capture-dark is saved here.",
+			DEFAULT_PROP_DARK_LOCATION,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_FLAT_LOCATION,
+		g_param_spec_string("flat-location", "Flat map",
+			"Binary PGM with a uniformly lit frame, each pixel is scaled so it comes out at the frame's mean. A map captured with capture-flat is saved here.",
+			DEFAULT_PROP_FLAT_LOCATION,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_HFLIP,
+		g_param_spec_boolean("hflip", "Horizontal flip",
+			"Mirror the image left to right, with the camera's ReverseX if it has one.",
+			DEFAULT_PROP_HFLIP,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_VFLIP,
+		g_param_spec_boolean("vflip", "Vertical flip",
+			"Turn the image upside down, with the camera's ReverseY if it has one.",
+			DEFAULT_PROP_VFLIP,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_ROTATION,
+		g_param_spec_enum("rotation", "Rotation",
+			"Clockwise rotation after the flips. 180 is done by the camera when it can reverse both axes, 90 and 270 are done while copying the frame.",
+			GST_TYPE_SPINNAKER_ROTATION, DEFAULT_PROP_ROTATION,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_AVERAGE_FRAMES,
+		g_param_spec_uint("average-frames", "Average frames",
+			"Average this many frames to reduce noise in low light, 0 or 1 to push frames as captured. Not used with HDR.",
+			0, GST_SPINNAKER_AVERAGE_MAX_FRAMES, DEFAULT_PROP_AVERAGE_FRAMES,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_AVERAGE_MODE,
+		g_param_spec_enum("average-mode", "Average mode",
+			"block pushes the mean of every average-frames frames, at that fraction of the camera's rate. recursive pushes every frame as a running average weighing the newest frame by 1 / average-frames, rounded to a power of two.",
+			GST_TYPE_SPINNAKER_AVERAGE_MODE, DEFAULT_PROP_AVERAGE_MODE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_CONVERSION_THREADS,
+		g_param_spec_uint("conversion-threads", "Conversion threads",
+			"Threads converting, correcting and copying each frame in bands of rows, including the streaming thread. Extra threads are started with the element, and pinned to their own CPU when cpu-affinity is set. 0 uses one per core.",
+			0, MAX_WORKER_THREADS, DEFAULT_PROP_CONVERSION_THREADS,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_CPU_AFFINITY,
+		g_param_spec_string("cpu-affinity", "CPU affinity",
+			"CPUs to run the streaming and conversion threads on, such as \"2-5,8\". The streaming thread takes the first, the conversion threads one each of the others. Frame memory is then allocated on these CPUs' NUMA node. Empty to run anywhere.",
+			DEFAULT_PROP_CPU_AFFINITY,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_SCHEDULING,
+		g_param_spec_enum("scheduling", "Scheduling",
+			"Scheduling policy of the streaming and conversion threads. The real-time policies need CAP_SYS_NICE or an rtprio limit, without them the threads keep the normal policy.",
+			GST_TYPE_SPINNAKER_SCHEDULING, DEFAULT_PROP_SCHEDULING,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_SCHEDULING_PRIORITY,
+		g_param_spec_int("scheduling-priority", "Scheduling priority",
+			"Priority with the fifo and rr scheduling policies",
+			1, 99, DEFAULT_PROP_SCHEDULING_PRIORITY,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_GATE_MODE,
+		g_param_spec_enum("gate-mode", "Gate mode",
+			"What to do with frames that did not change since the last one pushed: drop them, or push them flagged GAP so downstream can skip them. Frames are compared in 64x64 blocks on every 4th row. Not used with HDR.",
+			GST_TYPE_SPINNAKER_GATE_MODE, DEFAULT_PROP_GATE_MODE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_GATE_THRESHOLD,
+		g_param_spec_double("gate-threshold", "Gate threshold",
+			"A frame counts as changed when any block differs from the last frame pushed by this many grey levels on average. Keep it above the sensor's noise.",
+			0.0, 255.0, DEFAULT_PROP_GATE_THRESHOLD,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_GATE_KEEPALIVE,
+		g_param_spec_uint("gate-keepalive", "Gate keep-alive",
+			"Push a frame at least this often in ms even if nothing changed, 0 to push only changes.",
+			0, G_MAXUINT, DEFAULT_PROP_GATE_KEEPALIVE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_FRAMES_SUPPRESSED,
+		g_param_spec_uint64("frames-suppressed", "Frames suppressed",
+			"Frames dropped or flagged GAP by gate-mode since the element started.",
+			0, G_MAXUINT64, 0,
+			(GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+	g_object_class_install_property (gobject_class, PROP_RECONNECT,
+		g_param_spec_enum("reconnect", "Reconnect",
+			"What to do when the camera drops off the bus. hold and gap wait for the camera with the same serial number to come back, then restart it as it was set up. gap also pushes GAP events over the frames missed. An element message named \"spinnaker-reconnect\" is posted once it is back.",
+			GST_TYPE_SPINNAKER_RECONNECT, DEFAULT_PROP_RECONNECT,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_RECONNECT_TIMEOUT,
+		g_param_spec_uint("reconnect-timeout", "Reconnect timeout",
+			"Give up on a lost camera after this many ms and stop with an error, 0 to wait for good.",
+			0, G_MAXUINT, DEFAULT_PROP_RECONNECT_TIMEOUT,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+	g_object_class_install_property (gobject_class, PROP_RECONNECTS,
+		g_param_spec_uint("reconnects", "Reconnects",
+			"Times the camera came back since the element started.",
+			0, G_MAXUINT, 0,
+			(GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+	g_object_class_install_property (gobject_class, PROP_OUTAGE_TOTAL,
+		g_param_spec_uint64("outage-total", "Total outage",
+			"Time in ns the camera was gone since the element started.",
+			0, G_MAXUINT64, 0,
+			(GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+	g_object_class_install_property (gobject_class, PROP_OUTAGE_LAST,
+		g_param_spec_uint64("outage-last", "Last outage",
+			"Time in ns the camera was gone the last time, until frames were captured again.",
+			0, G_MAXUINT64, 0,
+			(GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+	/**
+	 * GstSpinnakerSrc::trigger:
+	 *
+	 * Push the frames held in the pre-trigger ring, with their original
+	 * timestamps, then carry on streaming. Sending a custom upstream event
+	 * named "spinnaker-trigger" does the same.
+	 */
+	gst_spinnaker_src_signals[SIGNAL_TRIGGER] =
+		g_signal_new ("trigger", G_TYPE_FROM_CLASS (klass),
+			G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstSpinnakerSrcClass, trigger),
+			NULL, NULL, NULL, G_TYPE_NONE, 0);
+	/**
+	 * GstSpinnakerSrc::arm:
+	 *
+	 * Stop pushing and start filling the pre-trigger ring again.
+	 */
+	gst_spinnaker_src_signals[SIGNAL_ARM] =
+		g_signal_new ("arm", G_TYPE_FROM_CLASS (klass),
+			G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstSpinnakerSrcClass, arm),
+			NULL, NULL, NULL, G_TYPE_NONE, 0);
+	/**
+	 * GstSpinnakerSrc::capture-dark:
+	 * @n_frames: frames to average
+	 *
+	 * Average the next @n_frames frames, taken with the lens capped, into a
+	 * new dark map and save it to dark-location if set. An element message
+	 * named "spinnaker-calibration" is posted once the map is in use and
+	 * the file, written off the streaming thread, is saved.
+	 */
+	gst_spinnaker_src_signals[SIGNAL_CAPTURE_DARK] =
+		g_signal_new ("capture-dark", G_TYPE_FROM_CLASS (klass),
+			G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstSpinnakerSrcClass, capture_dark),
+			NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_UINT);
+	/**
+	 * GstSpinnakerSrc::capture-flat:
+	 * @n_frames: frames to average
+	 *
+	 * Like capture-dark, for a uniformly lit, unsaturated scene. The gain
+	 * map is made from it and the current dark map.
+	 */
+	gst_spinnaker_src_signals[SIGNAL_CAPTURE_FLAT] =
+		g_signal_new ("capture-flat", G_TYPE_FROM_CLASS (klass),
+			G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstSpinnakerSrcClass, capture_flat),
+			NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_UINT);
+	g_object_class_install_property (gobject_class, PROP_THROUGHPUT_LIMIT,
+		g_param_spec_int("throughput-limit", "Throughput limit",
+			"Link throughput limit in bytes/s (DeviceLinkThroughputLimit), 0 leaves the camera setting unchanged.",
+			0, G_MAXINT, DEFAULT_PROP_THROUGHPUT_LIMIT,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_THROUGHPUT_AUTO,
+		g_param_spec_boolean("throughput-auto", "Automatic throughput limit",
+			"Share throughput-budget between all cameras in this process, weighted by the negotiated resolution, frame rate and pixel size. The shares are worked out again whenever a camera starts, negotiates or stops. Overrides throughput-limit.",
+			DEFAULT_PROP_THROUGHPUT_AUTO,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_THROUGHPUT_BUDGET,
+		g_param_spec_int64("throughput-budget", "Throughput budget",
+			"Total bytes/s available on the host controller, used when throughput-auto is set.",
+			1, G_MAXINT64, DEFAULT_PROP_THROUGHPUT_BUDGET,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
 }
 
 static void
@@ -534,7 +1508,72 @@ init_properties(GstSpinnakerSrc * src)
   src->nPitch = src->nWidth * src->nBytesPerPixel;
   src->gst_stride = src->nPitch;
   src->cameraID = DEFAULT_PROP_CAMERA;
+  src->serial = DEFAULT_PROP_SERIAL;
+  src->device_user_id = DEFAULT_PROP_DEVICE_USER_ID;
   src->exposure = DEFAULT_PROP_EXPOSURE;
+  src->gain = DEFAULT_PROP_GAIN;
+  src->exposure_just_changed = FALSE;
+  src->gain_just_changed = FALSE;
+  src->auto_exposure = DEFAULT_PROP_AUTO_EXPOSURE;
+  src->auto_gain = DEFAULT_PROP_AUTO_GAIN;
+  src->ae_target = DEFAULT_PROP_AE_TARGET;
+  src->ae_interval = DEFAULT_PROP_AE_INTERVAL;
+  src->ae_damping = DEFAULT_PROP_AE_DAMPING;
+  src->ae_max_gain = DEFAULT_PROP_AE_MAX_GAIN;
+  src->ae_frame_count = 0;
+  src->pretrigger_frames = DEFAULT_PROP_PRETRIGGER_FRAMES;
+  src->pretrigger_time = DEFAULT_PROP_PRETRIGGER_TIME;
+  src->pretrigger_preview = DEFAULT_PROP_PRETRIGGER_PREVIEW;
+  src->ring_pool = NULL;
+  src->ring = NULL;
+  src->ring_pushed = NULL;
+  src->ring_size = 0;
+  src->hdr_frames = DEFAULT_PROP_HDR_FRAMES;
+  src->hdr_ratio = DEFAULT_PROP_HDR_RATIO;
+  src->conversion_threads = DEFAULT_PROP_CONVERSION_THREADS;
+  src->workers = NULL;
+  src->band_stats = NULL;
+  src->cpu_affinity = DEFAULT_PROP_CPU_AFFINITY;
+  src->cpus = g_array_new (FALSE, FALSE, sizeof (gint));
+  src->scheduling = DEFAULT_PROP_SCHEDULING;
+  src->scheduling_priority = DEFAULT_PROP_SCHEDULING_PRIORITY;
+  src->streaming_thread = NULL;
+  src->streaming_state = NULL;
+  src->preview = NULL;
+  src->preview_scale = DEFAULT_PROP_PREVIEW_SCALE;
+  src->preview_rate = DEFAULT_PROP_PREVIEW_RATE;
+  src->preview_acc = NULL;
+  gst_video_info_init (&src->preview_info);
+  src->rois_string = DEFAULT_PROP_ROIS;
+  src->memory = DEFAULT_PROP_MEMORY;
+  src->blacklevel = DEFAULT_PROP_BLACKLEVEL;
+  src->dark_location = DEFAULT_PROP_DARK_LOCATION;
+  src->flat_location = DEFAULT_PROP_FLAT_LOCATION;
+  src->hflip = DEFAULT_PROP_HFLIP;
+  src->vflip = DEFAULT_PROP_VFLIP;
+  src->rotation = DEFAULT_PROP_ROTATION;
+  src->average_frames = DEFAULT_PROP_AVERAGE_FRAMES;
+  src->average_mode = DEFAULT_PROP_AVERAGE_MODE;
+  src->gate_mode = DEFAULT_PROP_GATE_MODE;
+  src->gate_threshold = DEFAULT_PROP_GATE_THRESHOLD;
+  src->gate_keepalive = DEFAULT_PROP_GATE_KEEPALIVE;
+  src->reconnect = DEFAULT_PROP_RECONNECT;
+  src->reconnect_timeout = DEFAULT_PROP_RECONNECT_TIMEOUT;
+  src->camera_serial = NULL;
+  g_mutex_init (&src->reconnect_lock);
+  g_cond_init (&src->reconnect_cond);
+  src->rois = g_array_new (FALSE, FALSE, sizeof (GstSpinnakerRoi));
+  src->roi_pads = NULL;
+  src->video_meta = FALSE;
+  src->allocator = NULL;
+  gst_allocation_params_init (&src->alloc_params);
+  gst_video_info_init (&src->vinfo);
+  src->statistics = DEFAULT_PROP_STATISTICS;
+  src->focus_metric = DEFAULT_PROP_FOCUS_METRIC;
+  src->throughput_limit = DEFAULT_PROP_THROUGHPUT_LIMIT;
+  src->throughput_auto = DEFAULT_PROP_THROUGHPUT_AUTO;
+  src->throughput_budget = DEFAULT_PROP_THROUGHPUT_BUDGET;
+  src->nRawBytesPerPixel = DEFAULT_RAW_BYTES_PER_PIXEL;
 
 }
 
@@ -550,6 +1589,10 @@ gst_spinnaker_src_init (GstSpinnakerSrc * src)
 	init_properties(src);
 
 	gst_spinnaker_src_reset (src);
+
+	// the extra pads follow the main pad's EOS, flushes and segments
+	gst_pad_add_probe (GST_BASE_SRC_PAD (src), GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+			gst_spinnaker_src_src_probe, src, NULL);
 }
 
 static void
@@ -557,11 +1600,109 @@ gst_spinnaker_src_reset (GstSpinnakerSrc * src)
 {
 	src->n_frames = 0;
 	src->total_timeouts = 0;
+	src->frames_suppressed = 0;
+	src->reconnects = 0;
+	src->outage_total = 0;
+	src->outage_last = 0;
+	src->discont = FALSE;
 	src->last_frame_time = 0;
-	src->cameraID = 0;
 	src->hCameraList = NULL;
+	src->hCamera = NULL;
 	src->cameraPresent = FALSE;
 	src->hSystem = NULL;
+	src->armed = FALSE;
+	src->trigger_pending = 0;
+	src->arm_pending = 0;
+	src->ring_head = 0;
+	src->ring_count = 0;
+	src->armed_frames = 0;
+	src->unlocking = FALSE;
+	src->hNodeMap = NULL;
+	src->fps_min = 0.0;
+	src->fps_max = 0.0;
+	src->latency_min = GST_CLOCK_TIME_NONE;
+	src->latency_max = GST_CLOCK_TIME_NONE;
+	src->readout_us = 0.0;
+	src->link_bps = 0;
+	src->stream_buffers = DEFAULT_STREAM_BUFFERS;
+	src->latency_dirty = FALSE;
+	src->hdr_active = FALSE;
+	src->hdr_chunk = FALSE;
+	src->hdr_next = 0;
+	memset (src->hdr_images, 0, sizeof (src->hdr_images));
+	src->preview_count = 0;
+	GST_OBJECT_LOCK (src);
+	if (src->preview)
+		src->preview->started = FALSE;
+	for (GList *l = src->roi_pads; l; l = l->next)
+		((GstSpinnakerAuxPad *) l->data)->started = FALSE;
+	GST_OBJECT_UNLOCK (src);
+}
+
+// Parses the rois property, "x,y,width,height" separated by ';'. Malformed
+// entries are kept as empty regions so the pad numbering doesn't shift.
+static void
+gst_spinnaker_src_parse_rois (GstSpinnakerSrc * src, const gchar * str)
+{
+	gchar **entries;
+	guint i;
+
+	g_free (src->rois_string);
+	src->rois_string = g_strdup (str);
+	g_array_set_size (src->rois, 0);
+	if (str == NULL)
+		return;
+
+	entries = g_strsplit (str, ";", -1);
+	for (i = 0; entries[i]; i++) {
+		GstSpinnakerRoi roi = { 0, };
+
+		if (g_strstrip (entries[i])[0] == '\0')
+			continue;
+		if (sscanf (entries[i], "%u,%u,%u,%u", &roi.x, &roi.y, &roi.width, &roi.height) != 4) {
+			GST_WARNING_OBJECT (src, "ignoring malformed ROI \"%s\"", entries[i]);
+			memset (&roi, 0, sizeof (roi));
+		}
+		g_array_append_val (src->rois, roi);
+	}
+	g_strfreev (entries);
+}
+
+// Parses a list of CPUs and CPU ranges such as "2-5,8"
+static void
+gst_spinnaker_src_parse_cpus (GstSpinnakerSrc * src, const gchar * str)
+{
+	gchar **entries;
+	guint i;
+
+	g_free (src->cpu_affinity);
+	src->cpu_affinity = g_strdup (str);
+	g_array_set_size (src->cpus, 0);
+	if (str == NULL)
+		return;
+
+	entries = g_strsplit (str, ",", -1);
+	for (i = 0; entries[i]; i++) {
+		guint first, last;
+		gint cpu;
+
+		if (g_strstrip (entries[i])[0] == '\0')
+			continue;
+		if (sscanf (entries[i], "%u-%u", &first, &last) != 2) {
+			if (sscanf (entries[i], "%u", &first) != 1) {
+				GST_WARNING_OBJECT (src, "ignoring malformed CPU \"%s\"", entries[i]);
+				continue;
+			}
+			last = first;
+		}
+		if (last < first || last >= MAX_CPUS) {
+			GST_WARNING_OBJECT (src, "ignoring CPU range \"%s\"", entries[i]);
+			continue;
+		}
+		for (cpu = first; cpu <= (gint) last; cpu++)
+			g_array_append_val (src->cpus, cpu);
+	}
+	g_strfreev (entries);
 }
 
 void
@@ -574,8 +1715,11 @@ gst_spinnaker_src_set_property (GObject * object, guint property_id,
 
 	spinImage hCamera = NULL;
 	spinNodeMapHandle hNodeMap = NULL;
-  	EXEANDCHECK(spinCameraListGet(src->hCameraList, src->cameraID, &hCamera));
-	EXEANDCHECK(spinCameraGetNodeMap(hCamera, &hNodeMap));
+	// only the geometry properties talk to the camera, the others are applied in start()
+	if (property_id == PROP_WIDTH || property_id == PROP_HEIGHT) {
+		hCamera = src->hCamera;
+		EXEANDCHECK(spinCameraGetNodeMap(hCamera, &hNodeMap));
+	}
 	spinNodeHandle hWidth = NULL;
 	int64_t maxWidth = 0;
 	spinNodeHandle hHeight = NULL;
@@ -585,6 +1729,14 @@ gst_spinnaker_src_set_property (GObject * object, guint property_id,
 		src->cameraID = g_value_get_int (value);
 		GST_DEBUG_OBJECT (src, "camera id: %d", src->cameraID);
 		break;
+	case PROP_SERIAL:
+		g_free (src->serial);
+		src->serial = g_value_dup_string (value);
+		break;
+	case PROP_DEVICE_USER_ID:
+		g_free (src->device_user_id);
+		src->device_user_id = g_value_dup_string (value);
+		break;
 	case PROP_WIDTH:
 
 		EXEANDCHECK(spinNodeMapGetNode(hNodeMap, "Width", &hWidth));
@@ -623,11 +1775,155 @@ gst_spinnaker_src_set_property (GObject * object, guint property_id,
 			}
 		}
 		break;
+	case PROP_THROUGHPUT_LIMIT:
+		src->throughput_limit = g_value_get_int (value);
+		break;
+	case PROP_THROUGHPUT_AUTO:
+		src->throughput_auto = g_value_get_boolean (value);
+		break;
+	case PROP_THROUGHPUT_BUDGET:
+		src->throughput_budget = g_value_get_int64 (value);
+		break;
+	case PROP_EXPOSURE:
+		src->exposure = g_value_get_float (value);
+		src->exposure_just_changed = TRUE;
+		break;
+	case PROP_GAIN:
+		src->gain = g_value_get_float (value);
+		src->gain_just_changed = TRUE;
+		break;
+	case PROP_AUTO_EXPOSURE:
+		src->auto_exposure = g_value_get_boolean (value);
+		// the loop needs both camera auto modes off. Turning it off leaves
+		// any exposure or gain still to be written pending.
+		if (src->auto_exposure)
+			src->exposure_just_changed = src->gain_just_changed = TRUE;
+		break;
+	case PROP_AUTO_GAIN:
+		src->auto_gain = g_value_get_boolean (value);
+		break;
+	case PROP_AE_TARGET:
+		src->ae_target = g_value_get_int (value);
+		break;
+	case PROP_AE_INTERVAL:
+		src->ae_interval = g_value_get_int (value);
+		break;
+	case PROP_AE_DAMPING:
+		src->ae_damping = g_value_get_double (value);
+		break;
+	case PROP_AE_MAX_GAIN:
+		src->ae_max_gain = g_value_get_float (value);
+		break;
+	case PROP_STATISTICS:
+		src->statistics = g_value_get_boolean (value);
+		break;
+	case PROP_FOCUS_METRIC:
+		src->focus_metric = g_value_get_boolean (value);
+		break;
+	case PROP_PRETRIGGER_FRAMES:
+		src->pretrigger_frames = g_value_get_uint (value);
+		break;
+	case PROP_PRETRIGGER_TIME:
+		src->pretrigger_time = g_value_get_uint (value);
+		break;
+	case PROP_PRETRIGGER_PREVIEW:
+		src->pretrigger_preview = g_value_get_uint (value);
+		break;
+	case PROP_HDR_FRAMES:
+		src->hdr_frames = g_value_get_uint (value);
+		break;
+	case PROP_HDR_RATIO:
+		src->hdr_ratio = g_value_get_double (value);
+		break;
+	case PROP_PREVIEW_SCALE:
+		src->preview_scale = g_value_get_uint (value);
+		break;
+	case PROP_PREVIEW_RATE:
+		src->preview_rate = g_value_get_double (value);
+		break;
+	case PROP_ROIS:
+		gst_spinnaker_src_parse_rois (src, g_value_get_string (value));
+		break;
+	case PROP_MEMORY:
+		src->memory = g_value_get_enum (value);
+		break;
+	case PROP_BLACKLEVEL:
+		src->blacklevel = g_value_get_int (value);
+		break;
+	case PROP_DARK_LOCATION:
+		g_free (src->dark_location);
+		src->dark_location = g_value_dup_string (value);
+		break;
+	case PROP_FLAT_LOCATION:
+		g_free (src->flat_location);
+		src->flat_location = g_value_dup_string (value);
+		break;
+	case PROP_HFLIP:
+		src->hflip = g_value_get_boolean (value);
+		break;
+	case PROP_VFLIP:
+		src->vflip = g_value_get_boolean (value);
+		break;
+	case PROP_ROTATION:
+		src->rotation = g_value_get_enum (value);
+		break;
+	case PROP_AVERAGE_FRAMES:
+		src->average_frames = g_value_get_uint (value);
+		break;
+	case PROP_AVERAGE_MODE:
+		src->average_mode = g_value_get_enum (value);
+		break;
+	case PROP_CONVERSION_THREADS:
+		src->conversion_threads = g_value_get_uint (value);
+		break;
+	case PROP_CPU_AFFINITY:
+		gst_spinnaker_src_parse_cpus (src, g_value_get_string (value));
+		break;
+	case PROP_SCHEDULING:
+		src->scheduling = g_value_get_enum (value);
+		break;
+	case PROP_SCHEDULING_PRIORITY:
+		src->scheduling_priority = g_value_get_int (value);
+		break;
+	case PROP_GATE_MODE:
+		src->gate_mode = g_value_get_enum (value);
+		break;
+	case PROP_GATE_THRESHOLD:
+		src->gate_threshold = g_value_get_double (value);
+		break;
+	case PROP_GATE_KEEPALIVE:
+		src->gate_keepalive = g_value_get_uint (value);
+		break;
+	case PROP_RECONNECT:
+		src->reconnect = g_value_get_enum (value);
+		break;
+	case PROP_RECONNECT_TIMEOUT:
+		src->reconnect_timeout = g_value_get_uint (value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 		break;
 	}
 
+	switch (property_id) {
+	case PROP_WIDTH:
+	case PROP_HEIGHT:
+	case PROP_EXPOSURE:
+	case PROP_THROUGHPUT_LIMIT:
+	case PROP_THROUGHPUT_AUTO:
+	case PROP_THROUGHPUT_BUDGET:
+	case PROP_PRETRIGGER_FRAMES:
+	case PROP_PRETRIGGER_TIME:
+	case PROP_HDR_FRAMES:
+	case PROP_HDR_RATIO:
+	case PROP_AVERAGE_FRAMES:
+	case PROP_AVERAGE_MODE:
+		src->latency_dirty = TRUE;
+		break;
+	default:
+		break;
+	}
+
 	fail:
 	return;
 }
@@ -640,22 +1936,174 @@ gst_spinnaker_src_get_property (GObject * object, guint property_id,
 
 	g_return_if_fail (GST_IS_SPINNAKER_SRC (object));
 	src = GST_SPINNAKER_SRC (object);
-}
-
-void
-gst_spinnaker_src_dispose (GObject * object)
-{
-	GstSpinnakerSrc *src;
-
-	g_return_if_fail (GST_IS_SPINNAKER_SRC (object));
-	src = GST_SPINNAKER_SRC (object);
-
-	GST_DEBUG_OBJECT (src, "dispose");
 
-	// clean up as possible.  may be called multiple times
-
-	G_OBJECT_CLASS (gst_spinnaker_src_parent_class)->dispose (object);
-}
+	switch (property_id) {
+	case PROP_CAMERA:
+		g_value_set_int (value, src->cameraID);
+		break;
+	case PROP_SERIAL:
+		g_value_set_string (value, src->serial);
+		break;
+	case PROP_DEVICE_USER_ID:
+		g_value_set_string (value, src->device_user_id);
+		break;
+	case PROP_THROUGHPUT_LIMIT:
+		g_value_set_int (value, src->throughput_limit);
+		break;
+	case PROP_THROUGHPUT_AUTO:
+		g_value_set_boolean (value, src->throughput_auto);
+		break;
+	case PROP_THROUGHPUT_BUDGET:
+		g_value_set_int64 (value, src->throughput_budget);
+		break;
+	case PROP_EXPOSURE:
+		g_value_set_float (value, src->exposure);
+		break;
+	case PROP_GAIN:
+		g_value_set_float (value, src->gain);
+		break;
+	case PROP_AUTO_EXPOSURE:
+		g_value_set_boolean (value, src->auto_exposure);
+		break;
+	case PROP_AUTO_GAIN:
+		g_value_set_boolean (value, src->auto_gain);
+		break;
+	case PROP_AE_TARGET:
+		g_value_set_int (value, src->ae_target);
+		break;
+	case PROP_AE_INTERVAL:
+		g_value_set_int (value, src->ae_interval);
+		break;
+	case PROP_AE_DAMPING:
+		g_value_set_double (value, src->ae_damping);
+		break;
+	case PROP_AE_MAX_GAIN:
+		g_value_set_float (value, src->ae_max_gain);
+		break;
+	case PROP_STATISTICS:
+		g_value_set_boolean (value, src->statistics);
+		break;
+	case PROP_FOCUS_METRIC:
+		g_value_set_boolean (value, src->focus_metric);
+		break;
+	case PROP_PRETRIGGER_FRAMES:
+		g_value_set_uint (value, src->pretrigger_frames);
+		break;
+	case PROP_PRETRIGGER_TIME:
+		g_value_set_uint (value, src->pretrigger_time);
+		break;
+	case PROP_PRETRIGGER_PREVIEW:
+		g_value_set_uint (value, src->pretrigger_preview);
+		break;
+	case PROP_HDR_FRAMES:
+		g_value_set_uint (value, src->hdr_frames);
+		break;
+	case PROP_HDR_RATIO:
+		g_value_set_double (value, src->hdr_ratio);
+		break;
+	case PROP_PREVIEW_SCALE:
+		g_value_set_uint (value, src->preview_scale);
+		break;
+	case PROP_PREVIEW_RATE:
+		g_value_set_double (value, src->preview_rate);
+		break;
+	case PROP_ROIS:
+		g_value_set_string (value, src->rois_string);
+		break;
+	case PROP_MEMORY:
+		g_value_set_enum (value, src->memory);
+		break;
+	case PROP_BLACKLEVEL:
+		g_value_set_int (value, src->blacklevel);
+		break;
+	case PROP_DARK_LOCATION:
+		g_value_set_string (value, src->dark_location);
+		break;
+	case PROP_FLAT_LOCATION:
+		g_value_set_string (value, src->flat_location);
+		break;
+	case PROP_HFLIP:
+		g_value_set_boolean (value, src->hflip);
+		break;
+	case PROP_VFLIP:
+		g_value_set_boolean (value, src->vflip);
+		break;
+	case PROP_ROTATION:
+		g_value_set_enum (value, src->rotation);
+		break;
+	case PROP_AVERAGE_FRAMES:
+		g_value_set_uint (value, src->average_frames);
+		break;
+	case PROP_AVERAGE_MODE:
+		g_value_set_enum (value, src->average_mode);
+		break;
+	case PROP_CONVERSION_THREADS:
+		g_value_set_uint (value, src->conversion_threads);
+		break;
+	case PROP_CPU_AFFINITY:
+		g_value_set_string (value, src->cpu_affinity);
+		break;
+	case PROP_SCHEDULING:
+		g_value_set_enum (value, src->scheduling);
+		break;
+	case PROP_SCHEDULING_PRIORITY:
+		g_value_set_int (value, src->scheduling_priority);
+		break;
+	case PROP_GATE_MODE:
+		g_value_set_enum (value, src->gate_mode);
+		break;
+	case PROP_GATE_THRESHOLD:
+		g_value_set_double (value, src->gate_threshold);
+		break;
+	case PROP_GATE_KEEPALIVE:
+		g_value_set_uint (value, src->gate_keepalive);
+		break;
+	case PROP_FRAMES_SUPPRESSED:
+		GST_OBJECT_LOCK (src);
+		g_value_set_uint64 (value, src->frames_suppressed);
+		GST_OBJECT_UNLOCK (src);
+		break;
+	case PROP_RECONNECT:
+		g_value_set_enum (value, src->reconnect);
+		break;
+	case PROP_RECONNECT_TIMEOUT:
+		g_value_set_uint (value, src->reconnect_timeout);
+		break;
+	case PROP_RECONNECTS:
+		GST_OBJECT_LOCK (src);
+		g_value_set_uint (value, src->reconnects);
+		GST_OBJECT_UNLOCK (src);
+		break;
+	case PROP_OUTAGE_TOTAL:
+		GST_OBJECT_LOCK (src);
+		g_value_set_uint64 (value, src->outage_total);
+		GST_OBJECT_UNLOCK (src);
+		break;
+	case PROP_OUTAGE_LAST:
+		GST_OBJECT_LOCK (src);
+		g_value_set_uint64 (value, src->outage_last);
+		GST_OBJECT_UNLOCK (src);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+		break;
+	}
+}
+
+void
+gst_spinnaker_src_dispose (GObject * object)
+{
+	GstSpinnakerSrc *src;
+
+	g_return_if_fail (GST_IS_SPINNAKER_SRC (object));
+	src = GST_SPINNAKER_SRC (object);
+
+	GST_DEBUG_OBJECT (src, "dispose");
+
+	// clean up as possible.  may be called multiple times
+
+	G_OBJECT_CLASS (gst_spinnaker_src_parent_class)->dispose (object);
+}
 
 void
 gst_spinnaker_src_finalize (GObject * object)
@@ -668,20 +2116,264 @@ gst_spinnaker_src_finalize (GObject * object)
 	GST_DEBUG_OBJECT (src, "finalize");
 
 	/* clean up object here */
+	// the pads themselves went away with the element's pad list
+	if (src->preview)
+		gst_spinnaker_src_aux_unref (src->preview);
+	g_free (src->preview_acc);
+	g_free (src->preview_scratch);
+	g_free (src->frame_scratch);
+	gst_spinnaker_src_average_free (src);
+	gst_spinnaker_gate_clear (&src->gate);
+	g_free (src->band_stats);
+	gst_object_replace ((GstObject **) & src->allocator, NULL);
+	g_free (src->cpu_affinity);
+	g_array_free (src->cpus, TRUE);
+	g_free (src->serial);
+	g_free (src->device_user_id);
+	g_free (src->camera_serial);
+	g_mutex_clear (&src->reconnect_lock);
+	g_cond_clear (&src->reconnect_cond);
+	g_free (src->streaming_state);
+	g_list_free_full (src->roi_pads, (GDestroyNotify) gst_spinnaker_src_aux_unref);
+	g_array_free (src->rois, TRUE);
+	g_free (src->rois_string);
+	gst_spinnaker_src_flat_free (src);
+	g_free (src->dark_location);
+	g_free (src->flat_location);
 	G_OBJECT_CLASS (gst_spinnaker_src_parent_class)->finalize (object);
 }
 
+static GstStateChangeReturn
+gst_spinnaker_src_change_state (GstElement * element, GstStateChange transition)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (element);
+	GstStateChangeReturn ret;
+
+	// register before any camera in the pipeline reaches start(), so that the
+	// automatic throughput limit can see all of them
+	if (transition == GST_STATE_CHANGE_NULL_TO_READY) {
+		G_LOCK (link_registry);
+		src->link_demand = 0.0;
+		link_registry = g_list_prepend (link_registry, src);
+		G_UNLOCK (link_registry);
+		gst_spinnaker_src_rebalance_links ();
+	}
+
+	ret = GST_ELEMENT_CLASS (gst_spinnaker_src_parent_class)->change_state (element, transition);
+
+	if (transition == GST_STATE_CHANGE_READY_TO_NULL ||
+			(transition == GST_STATE_CHANGE_NULL_TO_READY && ret == GST_STATE_CHANGE_FAILURE)) {
+		G_LOCK (link_registry);
+		link_registry = g_list_remove (link_registry, src);
+		G_UNLOCK (link_registry);
+		gst_spinnaker_src_rebalance_links ();
+	}
+
+	return ret;
+}
+
+// Picks the camera to open. A serial number is looked up directly, a
+// DeviceUserID by reading each camera's transport layer nodes, which
+// doesn't open them, and camera-id indexes the list in the SDK's order.
+static gboolean
+gst_spinnaker_src_select_camera (GstSpinnakerSrc * src, spinCamera * hCamera)
+{
+	size_t numCameras = 0, i;
+
+	*hCamera = NULL;
+	if (src->serial && src->serial[0]) {
+		if (spinCameraListGetBySerial(src->hCameraList, src->serial, hCamera) != SPINNAKER_ERR_SUCCESS ||
+				*hCamera == NULL) {
+			GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND,
+					("No camera with serial number %s found.", src->serial), (NULL));
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	EXEANDCHECK(spinCameraListGetSize(src->hCameraList, &numCameras));
+	if (src->device_user_id && src->device_user_id[0]) {
+		for (i = 0; i < numCameras; i++) {
+			gchar *user_id;
+
+			EXEANDCHECK(spinCameraListGet(src->hCameraList, i, hCamera));
+			user_id = gst_spinnaker_device_get_tl_string (*hCamera, "DeviceUserID");
+			if (g_strcmp0 (user_id, src->device_user_id) == 0) {
+				g_free (user_id);
+				return TRUE;
+			}
+			g_free (user_id);
+			spinCameraRelease(*hCamera);
+			*hCamera = NULL;
+		}
+		GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND,
+				("No camera with DeviceUserID %s found.", src->device_user_id), (NULL));
+		return FALSE;
+	}
+
+	if (src->cameraID >= numCameras) {
+		GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND,
+				("No camera %u found, there are %u.", src->cameraID, (guint) numCameras), (NULL));
+		return FALSE;
+	}
+	EXEANDCHECK(spinCameraListGet(src->hCameraList, src->cameraID, hCamera));
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
+// Called from the SDK's event thread
+static void
+gst_spinnaker_src_camera_removed (uint64_t deviceSerialNumber, void *pUserData)
+{
+	GstSpinnakerSrc *src = pUserData;
+	gchar *serial = g_strdup_printf ("%" G_GUINT64_FORMAT, (guint64) deviceSerialNumber);
+
+	if (g_strcmp0 (serial, src->camera_serial) == 0) {
+		GST_WARNING_OBJECT (src, "camera %s removed", serial);
+		g_atomic_int_set (&src->camera_lost, 1);
+	}
+	g_free (serial);
+}
+
+static void
+gst_spinnaker_src_camera_arrived (uint64_t deviceSerialNumber, void *pUserData)
+{
+	GstSpinnakerSrc *src = pUserData;
+	gchar *serial = g_strdup_printf ("%" G_GUINT64_FORMAT, (guint64) deviceSerialNumber);
+
+	if (g_strcmp0 (serial, src->camera_serial) == 0) {
+		GST_INFO_OBJECT (src, "camera %s arrived", serial);
+		g_mutex_lock (&src->reconnect_lock);
+		src->camera_arrived = TRUE;
+		g_cond_signal (&src->reconnect_cond);
+		g_mutex_unlock (&src->reconnect_lock);
+	}
+	g_free (serial);
+}
+
+// Remembers the open camera's serial number and follows its removal and
+// arrival, so it can be found again after dropping off the bus
+static void
+gst_spinnaker_src_watch_camera (GstSpinnakerSrc * src)
+{
+	g_free (src->camera_serial);
+	src->camera_serial = NULL;
+	src->camera_lost = 0;
+	src->camera_arrived = FALSE;
+	if (src->reconnect == GST_SPINNAKER_RECONNECT_OFF)
+		return;
+
+	src->camera_serial = gst_spinnaker_device_get_tl_string (src->hCamera, "DeviceSerialNumber");
+	if (src->camera_serial == NULL) {
+		GST_WARNING_OBJECT (src, "camera has no serial number, it won't be reconnected to");
+		return;
+	}
+
+	src->hRemoval = NULL;
+	if (spinRemovalEventCreate(&src->hRemoval, gst_spinnaker_src_camera_removed, src) != SPINNAKER_ERR_SUCCESS ||
+			spinSystemRegisterRemovalEvent(src->hSystem, src->hRemoval) != SPINNAKER_ERR_SUCCESS) {
+		if (src->hRemoval)
+			spinRemovalEventDestroy(src->hRemoval);
+		src->hRemoval = NULL;
+		GST_WARNING_OBJECT (src, "no removal events, a lost camera is only noticed when grabbing fails");
+	}
+	src->hArrival = NULL;
+	if (spinArrivalEventCreate(&src->hArrival, gst_spinnaker_src_camera_arrived, src) != SPINNAKER_ERR_SUCCESS ||
+			spinSystemRegisterArrivalEvent(src->hSystem, src->hArrival) != SPINNAKER_ERR_SUCCESS) {
+		if (src->hArrival)
+			spinArrivalEventDestroy(src->hArrival);
+		src->hArrival = NULL;
+		GST_WARNING_OBJECT (src, "no arrival events, a lost camera is looked for every %u ms", GRAB_TIMEOUT_MS);
+	}
+}
+
+static void
+gst_spinnaker_src_unwatch_camera (GstSpinnakerSrc * src)
+{
+	if (src->hRemoval) {
+		spinSystemUnregisterRemovalEvent(src->hSystem, src->hRemoval);
+		spinRemovalEventDestroy(src->hRemoval);
+		src->hRemoval = NULL;
+	}
+	if (src->hArrival) {
+		spinSystemUnregisterArrivalEvent(src->hSystem, src->hArrival);
+		spinArrivalEventDestroy(src->hArrival);
+		src->hArrival = NULL;
+	}
+	g_free (src->camera_serial);
+	src->camera_serial = NULL;
+}
+
+// Initialises a camera picked from the list and gives it the element's
+// configuration, up to where acquisition starts. A camera that comes back
+// after dropping off the bus is given the frame size negotiated before
+// instead of reporting its own.
+static gboolean
+gst_spinnaker_src_open_camera (GstSpinnakerSrc * src, spinCamera hCamera, gboolean restore)
+{
+	spinNodeMapHandle hNodeMap = NULL;
+	spinNodeMapHandle hNodeMapTLStream = NULL;
+	int64_t width = 0, height = 0, buffers = 0;
+
+	src->hCamera = hCamera;
+	GST_DEBUG_OBJECT (src, "initializing camera");
+	EXEANDCHECK(spinCameraInit(hCamera));
+
+	// Retrieve GenICam nodemap
+	EXEANDCHECK(spinCameraGetNodeMap(hCamera, &hNodeMap));
+	EXEANDCHECK(ConfigureCustomImageSettings(hNodeMap));
+
+	if (restore) {
+		gst_spinnaker_src_set_int_node (src, hNodeMap, "Width", src->nWidth, NULL);
+		gst_spinnaker_src_set_int_node (src, hNodeMap, "Height", src->nHeight, NULL);
+		if (!gst_spinnaker_src_get_int_node (src, hNodeMap, "Width", &width) ||
+				!gst_spinnaker_src_get_int_node (src, hNodeMap, "Height", &height) ||
+				width != src->nWidth || height != src->nHeight) {
+			GST_ERROR_OBJECT (src, "camera came back unable to capture %ux%u frames", src->nWidth, src->nHeight);
+			goto fail;
+		}
+	} else {
+		// pick up the geometry the camera actually ended up with
+		if (gst_spinnaker_src_get_int_node (src, hNodeMap, "Width", &width))
+			src->nWidth = width;
+		if (gst_spinnaker_src_get_int_node (src, hNodeMap, "Height", &height))
+			src->nHeight = height;
+		src->nPitch = src->nWidth * src->nBytesPerPixel;
+		src->gst_stride = src->nPitch;
+	}
+
+	// the link limit must be in place before streaming starts
+	gst_spinnaker_src_apply_link_limit (src, hNodeMap);
+	gst_spinnaker_src_setup_orientation (src, hNodeMap);
+
+	src->hNodeMap = hNodeMap;
+	gst_spinnaker_src_probe_framerate_range (src);
+
+	// frames the SDK can queue add to the worst case latency
+	if (spinCameraGetTLStreamNodeMap(hCamera, &hNodeMapTLStream) == SPINNAKER_ERR_SUCCESS &&
+			(gst_spinnaker_src_get_int_node (src, hNodeMapTLStream, "StreamBufferCountResult", &buffers) ||
+			 gst_spinnaker_src_get_int_node (src, hNodeMapTLStream, "StreamBufferCountManual", &buffers)) &&
+			buffers > 0)
+		src->stream_buffers = buffers;
+
+	return TRUE;
+
+	fail:
+	return FALSE;
+}
+
 //queries camera devices and begins acquisition
 static gboolean
 gst_spinnaker_src_start (GstBaseSrc * bsrc)
 {
 	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
-    size_t numCameras = 0;
+	guint n_threads;
 
 	GST_DEBUG_OBJECT (src, "start");
 	
   	spinError errReturn = SPINNAKER_ERR_SUCCESS;
-  	spinError err = SPINNAKER_ERR_SUCCESS;
 
 	//grab system reference
     EXEANDCHECK(spinSystemGetInstance(&src->hSystem));
@@ -690,51 +2382,49 @@ gst_spinnaker_src_start (GstBaseSrc * bsrc)
     EXEANDCHECK(spinCameraListCreateEmpty(&src->hCameraList));
 	GST_DEBUG_OBJECT (src, "getting camera list");
     EXEANDCHECK(spinSystemGetCameras(src->hSystem, src->hCameraList));
-	GST_DEBUG_OBJECT (src, "getting number of cameras");
-    EXEANDCHECK(spinCameraListGetSize(src->hCameraList, &numCameras));
-	
-	// display error when no camera has been found
-	if (numCameras==0){
-		GST_ERROR_OBJECT(src, "No Flycapture device found.");
-		
-   	 // Clear and destroy camera list before releasing system
-    	EXEANDCHECK(spinCameraListClear(src->hCameraList));
-
-    	EXEANDCHECK(spinCameraListDestroy(src->hCameraList));
-
-    	// Release system
-    	EXEANDCHECK(spinSystemReleaseInstance(src->hSystem));
-
-		GST_ERROR_OBJECT(src, "No device found.");
-		goto fail;
-	}
 
     // Select camera
   	spinCamera hCamera = NULL;
 	GST_DEBUG_OBJECT (src, "selecting camera");
-    EXEANDCHECK(spinCameraListGet(src->hCameraList, src->cameraID, &hCamera));
-	GST_DEBUG_OBJECT (src, "initializing camera");
-    EXEANDCHECK(spinCameraInit(hCamera));
-    
-	// Retrieve GenICam nodemap
-    spinNodeMapHandle hNodeMap = NULL;
-
-    err = spinCameraGetNodeMap(hCamera, &hNodeMap);
-    if (err != SPINNAKER_ERR_SUCCESS)
-    {
-        printf("Unable to retrieve GenICam nodemap. Aborting with error %d...\n\n", err);
-        return err;
-    }
-	    err = ConfigureCustomImageSettings(hNodeMap);
-    if (err != SPINNAKER_ERR_SUCCESS)
-    {
-        return err;
-    }
+	if (!gst_spinnaker_src_select_camera (src, &hCamera))
+		goto fail;
+	if (!gst_spinnaker_src_open_camera (src, hCamera, FALSE))
+		goto fail;
+	spinNodeMapHandle hNodeMap = src->hNodeMap;
+	gst_spinnaker_src_watch_camera (src);
+
+	// start the exposure loop (and the properties) from what the camera is using
+	double current;
+	if (!src->exposure_just_changed &&
+			gst_spinnaker_src_get_float_node (src, hNodeMap, "ExposureTime", &current, NULL, NULL))
+		src->exposure = current / 1000.0;
+	if (!src->gain_just_changed &&
+			gst_spinnaker_src_get_float_node (src, hNodeMap, "Gain", &current, NULL, NULL))
+		src->gain = current;
+
+	// the bracket starts from the exposure just read or set
+	if (!gst_spinnaker_src_setup_sequencer (src, hNodeMap))
+		goto fail;
+	if (src->hdr_active && src->auto_exposure)
+		GST_WARNING_OBJECT (src, "auto-exposure has no effect on HDR brackets");
+
+	// started once here, so frames only wake the threads up
+	src->thread_config.cpus = src->cpus->len ? (const gint *) src->cpus->data : NULL;
+	src->thread_config.n_cpus = src->cpus->len;
+	src->thread_config.scheduling = src->scheduling;
+	src->thread_config.priority = src->scheduling_priority;
+	src->streaming_thread = NULL;
+	n_threads = src->conversion_threads ? src->conversion_threads :
+			MIN (src->cpus->len ? src->cpus->len : g_get_num_processors (), MAX_WORKER_THREADS);
+	src->workers = gst_spinnaker_workers_new (n_threads, &src->thread_config);
+	if (!gst_spinnaker_workers_is_set_up (src->workers))
+		GST_WARNING_OBJECT (src, "the conversion threads can't be pinned or scheduled as asked, running them as they are");
+	src->band_stats = g_new0 (GstSpinnakerFrameStats, n_threads);
+	GST_INFO_OBJECT (src, "%u conversion threads", n_threads);
 
 	//starts camera acquisition. Doesn't actually fill the gstreamer buffer. see create function
 	GST_DEBUG_OBJECT (src, "starting acquisition");
     EXEANDCHECK(spinCameraBeginAcquisition(hCamera));
-	EXEANDCHECK(spinCameraRelease(hCamera));
 	// NOTE:
 	// from now on, the "deviceContext" handle can be used to access the camera board.
 	// use fc2DestroyContext to end the usage
@@ -744,6 +2434,22 @@ gst_spinnaker_src_start (GstBaseSrc * bsrc)
 
 	fail:
 
+	gst_spinnaker_workers_free (src->workers);
+	src->workers = NULL;
+	g_free (src->band_stats);
+	src->band_stats = NULL;
+	gst_spinnaker_src_unwatch_camera (src);
+	if (src->hCamera) {
+		bool8_t initialized = False;
+
+		// opened, so the next start finds it closed again
+		if (spinCameraIsInitialized(src->hCamera, &initialized) == SPINNAKER_ERR_SUCCESS && initialized)
+			spinCameraDeInit(src->hCamera);
+		spinCameraRelease(src->hCamera);
+		src->hCamera = NULL;
+	}
+	src->hNodeMap = NULL;
+
     // Clear and destroy camera list before releasing system
     spinCameraListClear(src->hCameraList);
 
@@ -755,6 +2461,27 @@ gst_spinnaker_src_start (GstBaseSrc * bsrc)
 	return FALSE;
 }
 
+// Ends acquisition and lets go of the camera. Returns FALSE if the camera
+// didn't take it, which is expected of one that is gone: it is let go of
+// all the same.
+static gboolean
+gst_spinnaker_src_close_camera (GstSpinnakerSrc * src)
+{
+	spinCamera hCamera = src->hCamera;
+	gboolean ok = TRUE;
+
+	ok &= spinCameraEndAcquisition(hCamera) == SPINNAKER_ERR_SUCCESS;
+	// don't leave the camera cycling exposures for the next user
+	if (src->hdr_active)
+		gst_spinnaker_src_set_enum_node (src, src->hNodeMap, "SequencerMode", "Off");
+	ok &= spinCameraDeInit(hCamera) == SPINNAKER_ERR_SUCCESS;
+	ok &= spinCameraRelease(hCamera) == SPINNAKER_ERR_SUCCESS;
+	src->hCamera = NULL;
+	src->hNodeMap = NULL;
+
+	return ok;
+}
+
 //stops streaming and closes the camera
 static gboolean
 gst_spinnaker_src_stop (GstBaseSrc * bsrc)
@@ -762,11 +2489,33 @@ gst_spinnaker_src_stop (GstBaseSrc * bsrc)
 	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
 
 	GST_DEBUG_OBJECT (src, "stop");
-	spinImage hCamera = NULL;
-	EXEANDCHECK(spinCameraListGet(src->hCameraList, src->cameraID, &hCamera));
-  	EXEANDCHECK(spinCameraEndAcquisition(hCamera));
-  	EXEANDCHECK(spinCameraDeInit(hCamera));
-  	EXEANDCHECK(spinCameraRelease(hCamera));
+	gst_spinnaker_src_free_ring (src);
+
+	gst_spinnaker_src_hdr_clear (src);
+	g_free (src->calib_acc);
+	src->calib_acc = NULL;
+	src->calib = GST_SPINNAKER_CALIBRATION_NONE;
+	gst_spinnaker_src_average_free (src);
+	gst_spinnaker_gate_clear (&src->gate);
+	gst_spinnaker_workers_free (src->workers);
+	src->workers = NULL;
+	g_free (src->band_stats);
+	src->band_stats = NULL;
+	// only the streaming thread itself can be given back as it was
+	g_free (src->streaming_state);
+	src->streaming_state = NULL;
+	src->streaming_thread = NULL;
+	if (src->fd_pool) {
+		gst_object_unref (src->fd_pool);
+		src->fd_pool = NULL;
+	}
+	gst_object_replace ((GstObject **) & src->allocator, NULL);
+	gst_allocation_params_init (&src->alloc_params);
+
+	gst_spinnaker_src_unwatch_camera (src);
+	// a camera lost for good is already closed
+	if (src->hCamera && !gst_spinnaker_src_close_camera (src))
+		goto fail;
 
 	EXEANDCHECK(spinCameraListClear(src->hCameraList));
 	EXEANDCHECK(spinCameraListDestroy(src->hCameraList));
@@ -780,148 +2529,2141 @@ gst_spinnaker_src_stop (GstBaseSrc * bsrc)
 	return TRUE;
 }
 
-static GstCaps *
-gst_spinnaker_src_get_caps (GstBaseSrc * bsrc, GstCaps * filter)
+static void
+gst_spinnaker_src_free_ring (GstSpinnakerSrc * src)
 {
-	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
-	GstCaps *caps;
+	guint i;
+
+	for (i = 0; i < src->ring_count; i++)
+		gst_buffer_unref (src->ring[(src->ring_head + i) % src->ring_size]);
+	src->ring_head = 0;
+	src->ring_count = 0;
+	src->armed = FALSE;
+
+	g_free (src->ring);
+	src->ring = NULL;
+	g_free (src->ring_pushed);
+	src->ring_pushed = NULL;
+	src->ring_size = 0;
+
+	if (src->ring_pool) {
+		gst_buffer_pool_set_active (src->ring_pool, FALSE);
+		gst_object_unref (src->ring_pool);
+		src->ring_pool = NULL;
+	}
+}
 
-	GstVideoInfo vinfo;
+// Preallocates everything the pre-trigger ring needs, so nothing is
+// allocated per frame while armed
+static gboolean
+gst_spinnaker_src_setup_ring (GstSpinnakerSrc * src, GstCaps * caps, gsize frame_size)
+{
+	GstStructure *config;
+	guint n;
+
+	gst_spinnaker_src_free_ring (src);
+
+	n = MAX(src->pretrigger_frames, (guint) ceil (src->pretrigger_time * src->framerate / 1000.0));
+	if (n == 0)
+		return TRUE;
+
+	src->ring = g_new0 (GstBuffer *, n);
+	src->ring_pushed = g_new0 (gboolean, n);
+	src->ring_size = n;
+
+	// one extra buffer for the frame being captured, one for a preview downstream
+	src->ring_pool = gst_buffer_pool_new ();
+	config = gst_buffer_pool_get_config (src->ring_pool);
+	gst_buffer_pool_config_set_params (config, caps, frame_size, n + 2, n + 2);
+	if (!gst_buffer_pool_set_config (src->ring_pool, config) ||
+			!gst_buffer_pool_set_active (src->ring_pool, TRUE)) {
+		GST_ELEMENT_ERROR (src, RESOURCE, NO_SPACE_LEFT,
+				("Unable to allocate %u frames for the pre-trigger ring", n), (NULL));
+		gst_spinnaker_src_free_ring (src);
+		return FALSE;
+	}
 
-	gst_video_info_init(&vinfo);
+	GST_INFO_OBJECT (src, "pre-trigger ring of %u frames (%" G_GSIZE_FORMAT " bytes) armed", n, n * frame_size);
+	src->armed = TRUE;
+	return TRUE;
+}
 
-	vinfo.width = src->nWidth;
-	vinfo.height = src->nHeight;
-	vinfo.fps_n = 0; //0 means variable FPS
-	vinfo.fps_d = 1;
-	vinfo.interlace_mode = GST_VIDEO_INTERLACE_MODE_PROGRESSIVE;
-	vinfo.finfo = gst_video_format_get_info(DEFAULT_GST_VIDEO_FORMAT);
-  
-	caps = gst_video_info_to_caps(&vinfo);
+static void
+gst_spinnaker_src_trigger (GstSpinnakerSrc * src)
+{
+	GST_DEBUG_OBJECT (src, "trigger");
+	g_atomic_int_set (&src->trigger_pending, 1);
+}
 
-	GST_DEBUG_OBJECT (src, "The caps are %" GST_PTR_FORMAT, caps);
+static void
+gst_spinnaker_src_arm (GstSpinnakerSrc * src)
+{
+	GST_DEBUG_OBJECT (src, "arm");
+	g_atomic_int_set (&src->arm_pending, 1);
+}
 
-	return caps;
+static gboolean
+gst_spinnaker_src_event (GstBaseSrc * bsrc, GstEvent * event)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
+
+	if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_UPSTREAM &&
+			gst_event_has_name (event, PRETRIGGER_EVENT_NAME)) {
+		gst_spinnaker_src_trigger (src);
+		return TRUE;
+	}
+
+	return GST_BASE_SRC_CLASS (gst_spinnaker_src_parent_class)->event (bsrc, event);
 }
 
 static gboolean
-gst_spinnaker_src_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
+gst_spinnaker_src_unlock (GstBaseSrc * bsrc)
 {
 	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
-	GstVideoInfo vinfo;
 
-	//Currently using fixed caps
-	GST_DEBUG_OBJECT (src, "The caps being set are %" GST_PTR_FORMAT, caps);
-	src->acq_started = TRUE;
+	GST_OBJECT_LOCK (src);
+	src->unlocking = TRUE;
+	GST_OBJECT_UNLOCK (src);
+	return TRUE;
+}
+
+static gboolean
+gst_spinnaker_src_unlock_stop (GstBaseSrc * bsrc)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
 
+	GST_OBJECT_LOCK (src);
+	src->unlocking = FALSE;
+	GST_OBJECT_UNLOCK (src);
 	return TRUE;
+}
 
-	unsupported_caps:
-	GST_ERROR_OBJECT (src, "Unsupported caps: %" GST_PTR_FORMAT, caps);
-	return FALSE;
+// Reads what the latency estimate needs from the camera: the sensor readout
+// time and the link rate. Called once the frame rate is programmed.
+static void
+gst_spinnaker_src_probe_latency (GstSpinnakerSrc * src)
+{
+	double readout = 0.0, max_fps = 0.0;
+	int64_t bps = 0;
+
+	if (src->hNodeMap == NULL)
+		return;
+
+	// without a readout node, the fastest frame rate bounds it
+	if (gst_spinnaker_src_get_float_node (src, src->hNodeMap, "SensorReadoutTime", &readout, NULL, NULL) &&
+			readout > 0.0)
+		src->readout_us = readout;
+	else if (gst_spinnaker_src_get_float_node (src, src->hNodeMap, "AcquisitionFrameRate", NULL, NULL, &max_fps) &&
+			max_fps > 0.0)
+		src->readout_us = 1000000.0 / max_fps;
+
+	if ((gst_spinnaker_src_get_int_node (src, src->hNodeMap, "DeviceLinkThroughputLimit", &bps) ||
+			gst_spinnaker_src_get_int_node (src, src->hNodeMap, "DeviceLinkSpeed", &bps)) && bps > 0)
+		src->link_bps = bps;
+}
 
-	fail:
-	return FALSE;
+// Estimates how long after its exposure starts a frame is pushed: exposure,
+// readout and transfer at least, plus the frames the SDK and the pre-trigger
+// ring may hold at worst. HDR and block averaged frames also wait for the
+// rest of their frames.
+// A latency message is posted when the estimate moves noticeably, so the
+// auto exposure loop doesn't make the pipeline recalculate on every step.
+static void
+gst_spinnaker_src_update_latency (GstSpinnakerSrc * src)
+{
+	GstClockTime duration, capture_period, exposure, readout, transfer, min, max;
+	guint per_frame = src->hdr_active ? src->hdr_frames : gst_spinnaker_src_average_block (src);
+	gboolean changed;
+
+	src->latency_dirty = FALSE;
+	if (src->framerate <= 0.0)
+		return;
+
+	duration = gst_util_uint64_scale_int (GST_SECOND, 1000, (gint) (src->framerate * 1000.0));
+	capture_period = duration / per_frame;
+	exposure = src->hdr_active ? (GstClockTime) (src->hdr_exposure[per_frame - 1] * GST_USECOND)
+			: (GstClockTime) (src->exposure * GST_MSECOND);
+	readout = (GstClockTime) (src->readout_us * GST_USECOND);
+	transfer = src->link_bps > 0 ? gst_util_uint64_scale (
+			(guint64) src->nWidth * src->nHeight * src->nRawBytesPerPixel, GST_SECOND, src->link_bps) : 0;
+
+	min = (per_frame - 1) * capture_period + exposure + readout + transfer;
+	max = min + (src->stream_buffers - 1) * capture_period + src->ring_size * duration;
+
+	GST_OBJECT_LOCK (src);
+	changed = !GST_CLOCK_TIME_IS_VALID (src->latency_min) ||
+			ABS ((gint64) min - (gint64) src->latency_min) * 100 > (gint64) src->latency_min * LATENCY_HYSTERESIS ||
+			ABS ((gint64) max - (gint64) src->latency_max) * 100 > (gint64) src->latency_max * LATENCY_HYSTERESIS;
+	if (changed) {
+		src->latency_min = min;
+		src->latency_max = max;
+	}
+	GST_OBJECT_UNLOCK (src);
+
+	if (changed) {
+		GST_INFO_OBJECT (src, "latency min %" GST_TIME_FORMAT " (exposure %" GST_TIME_FORMAT
+				", readout %" GST_TIME_FORMAT ", transfer %" GST_TIME_FORMAT "), max %" GST_TIME_FORMAT,
+				GST_TIME_ARGS (min), GST_TIME_ARGS (exposure), GST_TIME_ARGS (readout),
+				GST_TIME_ARGS (transfer), GST_TIME_ARGS (max));
+		gst_element_post_message (GST_ELEMENT (src), gst_message_new_latency (GST_OBJECT (src)));
+	}
 }
 
-//Grabs next image from camera and puts it into a gstreamer buffer
-#ifdef OVERRIDE_CREATE
-static GstFlowReturn
-gst_spinnaker_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+static gboolean
+gst_spinnaker_src_query (GstBaseSrc * bsrc, GstQuery * query)
 {
-	spinError err = SPINNAKER_ERR_SUCCESS;
-	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (psrc);
-	GstMapInfo minfo;
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
+	GstClockTime min, max;
 
-	//query camera and grab next image
-	spinImage hResultImage = NULL;
-	spinImage hCamera = NULL;
-	EXEANDCHECK(spinCameraListGet(src->hCameraList, src->cameraID, &hCamera));
-	EXEANDCHECK(spinCameraGetNextImage(hCamera, &hResultImage));
-	EXEANDCHECK(spinCameraRelease(hCamera));
+	if (GST_QUERY_TYPE (query) != GST_QUERY_LATENCY)
+		return GST_BASE_SRC_CLASS (gst_spinnaker_src_parent_class)->query (bsrc, query);
 
-	bool8_t isIncomplete = False;
-	bool8_t hasFailed = False;
+	GST_OBJECT_LOCK (src);
+	min = src->latency_min;
+	max = src->latency_max;
+	GST_OBJECT_UNLOCK (src);
 
-	//check if image is complete 
-	//WARNING: This returns a boolean and is not handled if the image is incomplete
-	EXEANDCHECK(spinImageIsIncomplete(hResultImage, &isIncomplete));
+	// without an estimate, such as at a variable rate, answer as a live
+	// source does by default
+	if (!GST_CLOCK_TIME_IS_VALID (min))
+		return GST_BASE_SRC_CLASS (gst_spinnaker_src_parent_class)->query (bsrc, query);
 
-	// Create a new buffer for the image
-	//printf("Bytes per pixel are %d\n"),src->nBytesPerPixel;
-	//*buf = gst_buffer_new_and_alloc (src->nHeight * src->nWidth * src->nBytesPerPixel);
-	*buf = gst_buffer_new_and_alloc (src->nHeight * src->nWidth * 16);
-	//printf("Bytes per pixel are %d\n"),src->nBytesPerPixel;
+	GST_DEBUG_OBJECT (src, "latency min %" GST_TIME_FORMAT " max %" GST_TIME_FORMAT,
+			GST_TIME_ARGS (min), GST_TIME_ARGS (max));
+	gst_query_set_latency (query, TRUE, min, max);
+	return TRUE;
+}
 
-	gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
+static gboolean
+gst_spinnaker_src_transposed (GstSpinnakerSrc * src)
+{
+	return src->rotation == GST_SPINNAKER_ROTATION_90 || src->rotation == GST_SPINNAKER_ROTATION_270;
+}
 
+// Hands the axis reversals to the camera where it has ReverseX / ReverseY,
+// which costs nothing, and leaves the rest to the copy pass. The nodes are
+// written either way so a previous user's setting doesn't stick.
+static void
+gst_spinnaker_src_setup_orientation (GstSpinnakerSrc * src, spinNodeMapHandle hNodeMap)
+{
+	GstSpinnakerOrientation *o = &src->orient;
 
-	spinImage hConvertedImage = NULL;
+	gst_spinnaker_orientation_init (o, src->hflip, src->vflip, src->rotation);
+	if (gst_spinnaker_src_set_bool_node (src, hNodeMap, "ReverseX", o->reverse_x))
+		o->reverse_x = FALSE;
+	if (gst_spinnaker_src_set_bool_node (src, hNodeMap, "ReverseY", o->reverse_y))
+		o->reverse_y = FALSE;
 
-    err = spinImageCreateEmpty(&hConvertedImage);
-    if (err != SPINNAKER_ERR_SUCCESS)
-    {
-        printf("Unable to create image. Non-fatal error %d...\n\n", err);
-        hasFailed = True;
-    }
+	src->orient_sw = o->reverse_x || o->reverse_y || o->transpose;
+	GST_INFO_OBJECT (src, "orientation in software: reverse x %d, reverse y %d, transpose %d",
+			o->reverse_x, o->reverse_y, o->transpose);
+}
 
-    err = spinImageConvert(hResultImage, PixelFormat_Mono8, hConvertedImage);
-    if (err != SPINNAKER_ERR_SUCCESS)
+// Offers our memfd / DMABuf pool in place of whatever downstream proposed.
+// The base class configures and activates it like any other pool.
+static void
+gst_spinnaker_src_propose_fd_pool (GstSpinnakerSrc * src, GstQuery * query)
+{
+	GstBufferPool *pool;
+	guint size = 0, min = 0, max = 0;
+
+	pool = gst_spinnaker_fd_pool_new (src->memory);
+	if (pool == NULL) {
+		GST_ELEMENT_WARNING (src, RESOURCE, SETTINGS,
+				("No file descriptor backed memory available, using system memory"), (NULL));
+		return;
+	}
+
+	if (gst_query_get_n_allocation_pools (query) > 0)
+		gst_query_parse_nth_allocation_pool (query, 0, NULL, &size, &min, &max);
+	// frames may be held by other processes for a while, the pool grows unless downstream caps it
+	min = MAX (min, MIN_FD_BUFFERS);
+	size = GST_VIDEO_INFO_SIZE (&src->vinfo);
+
+	if (gst_query_get_n_allocation_pools (query) > 0)
+		gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+	else
+		gst_query_add_allocation_pool (query, pool, size, min, max);
+	gst_object_unref (pool);
+}
+
+// Frames are handed over in the SDK's own layout when downstream can take
+// its stride from a GstVideoMeta, or copied once into fd backed memory
+// when that was asked for
+static gboolean
+gst_spinnaker_src_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
+
+	src->video_meta = gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+	GST_DEBUG_OBJECT (src, "downstream %s GstVideoMeta", src->video_meta ? "supports" : "does not support");
+
+	if (src->fd_pool) {
+		gst_object_unref (src->fd_pool);
+		src->fd_pool = NULL;
+	}
+	if (src->memory != GST_SPINNAKER_MEMORY_SYSTEM)
+		gst_spinnaker_src_propose_fd_pool (src, query);
+
+	if (!GST_BASE_SRC_CLASS (gst_spinnaker_src_parent_class)->decide_allocation (bsrc, query))
+		return FALSE;
+
+	// e.g. the block alignment spinnakerrawsink needs to write frames as they are
+	gst_object_replace ((GstObject **) & src->allocator, NULL);
+	gst_allocation_params_init (&src->alloc_params);
+	if (gst_query_get_n_allocation_params (query) > 0)
+		gst_query_parse_nth_allocation_param (query, 0, &src->allocator, &src->alloc_params);
+
+	if (src->memory != GST_SPINNAKER_MEMORY_SYSTEM) {
+		GstBufferPool *pool = gst_base_src_get_buffer_pool (bsrc);
+
+		if (GST_IS_SPINNAKER_FD_POOL (pool))
+			src->fd_pool = pool;
+		else if (pool)
+			gst_object_unref (pool);
+	}
+	return TRUE;
+}
+
+static GstCaps *
+gst_spinnaker_src_get_caps (GstBaseSrc * bsrc, GstCaps * filter)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
+	GstCaps *caps;
+	gdouble min_fps, max_fps;
+	gint min_n, min_d, max_n, max_d;
+
+	GstVideoInfo vinfo;
+
+	gst_video_info_init(&vinfo);
+
+	vinfo.width = gst_spinnaker_src_transposed (src) ? src->nHeight : src->nWidth;
+	vinfo.height = gst_spinnaker_src_transposed (src) ? src->nWidth : src->nHeight;
+	vinfo.fps_n = 0; //0 means variable FPS
+	vinfo.fps_d = 1;
+	vinfo.interlace_mode = GST_VIDEO_INTERLACE_MODE_PROGRESSIVE;
+	vinfo.finfo = gst_video_format_get_info(src->hdr_frames >= 2 ? HDR_GST_VIDEO_FORMAT : DEFAULT_GST_VIDEO_FORMAT);
+  
+	caps = gst_video_info_to_caps(&vinfo);
+
+	// advertise the frame rates the camera can actually deliver right now,
+	// an HDR frame takes a whole bracket, a block average average-frames
+	if (src->fps_max > 0.0) {
+		guint per_frame = src->hdr_frames >= 2 ? src->hdr_frames : gst_spinnaker_src_average_block (src);
+
+		min_fps = src->fps_min / per_frame;
+		max_fps = src->fps_max / per_frame;
+		gst_util_double_to_fraction (min_fps, &min_n, &min_d);
+		gst_util_double_to_fraction (max_fps, &max_n, &max_d);
+		gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION_RANGE,
+				min_n, min_d, max_n, max_d, NULL);
+	} else if (src->hNodeMap == NULL) {
+		// not opened yet, the camera's rates aren't known
+		gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION_RANGE,
+				0, 1, G_MAXINT, 1, NULL);
+	}
+	// else the rate can't be set, the camera free-runs at the variable 0/1
+
+	if (filter) {
+		GstCaps *tmp = gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref (caps);
+		caps = tmp;
+	}
+
+	GST_DEBUG_OBJECT (src, "The caps are %" GST_PTR_FORMAT, caps);
+
+	return caps;
+}
+
+// Run the camera as fast as it can unless downstream asks for less. This
+// picks the top of the advertised range, the camera's maximum rate at its
+// current exposure, where there used to be a fixed 31 fps.
+static GstCaps *
+gst_spinnaker_src_fixate (GstBaseSrc * bsrc, GstCaps * caps)
+{
+	GstStructure *structure;
+
+	caps = gst_caps_make_writable (caps);
+	structure = gst_caps_get_structure (caps, 0);
+	gst_structure_fixate_field_nearest_fraction (structure, "framerate", G_MAXINT, 1);
+
+	return GST_BASE_SRC_CLASS (gst_spinnaker_src_parent_class)->fixate (bsrc, caps);
+}
+
+// Programs the negotiated rate so the camera never captures frames we
+// would drop
+static gboolean
+gst_spinnaker_src_apply_framerate (GstSpinnakerSrc * src, const GstVideoInfo * vinfo)
+{
+	guint per_frame = src->hdr_active ? src->hdr_frames : gst_spinnaker_src_average_block (src);
+	gdouble fps = 0.0, applied = 0.0;
+
+	if (src->hNodeMap == NULL)
+		return TRUE;
+
+	gst_spinnaker_src_probe_framerate_range (src);
+	if (vinfo->fps_n > 0) {
+		gst_util_fraction_to_double (vinfo->fps_n, vinfo->fps_d, &fps);
+		if (src->fps_max <= 0.0 ||
+				!gst_spinnaker_src_set_float_node (src, src->hNodeMap, "AcquisitionFrameRate", fps * per_frame, &applied)) {
+			GST_ERROR_OBJECT (src, "Unable to set the frame rate to %f", fps * per_frame);
+			return FALSE;
+		}
+		src->framerate = applied / per_frame;
+	} else {
+		// variable rate, free-run and just report what the camera does
+		gst_spinnaker_src_enable_framerate (src, FALSE);
+		gst_spinnaker_src_get_float_node (src, src->hNodeMap, "AcquisitionResultingFrameRate", &fps, NULL, NULL);
+		if (fps > 0.0)
+			src->framerate = fps / per_frame;
+	}
+	GST_INFO_OBJECT (src, "camera running at %f fps", src->framerate);
+	return TRUE;
+}
+
+static gboolean
+gst_spinnaker_src_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (bsrc);
+	GstVideoInfo vinfo;
+
+	GST_DEBUG_OBJECT (src, "The caps being set are %" GST_PTR_FORMAT, caps);
+	// what is allocated from here on belongs on the streaming thread's node
+	gst_spinnaker_src_setup_streaming_thread (src);
+
+	if (!gst_video_info_from_caps (&vinfo, caps))
+		goto unsupported_caps;
+
+	src->gst_stride = GST_VIDEO_INFO_PLANE_STRIDE (&vinfo, 0);
+
+	if (!gst_spinnaker_src_apply_framerate (src, &vinfo))
+		goto fail;
+
+	// share the link by what was negotiated, and take this camera's share now
+	gst_spinnaker_src_set_link_demand (src, (gdouble) src->nWidth * src->nHeight * src->nRawBytesPerPixel *
+			src->framerate * (src->hdr_active ? src->hdr_frames : gst_spinnaker_src_average_block (src)));
+	g_atomic_int_set (&src->link_dirty, 0);
+	gst_spinnaker_src_apply_link_limit (src, src->hNodeMap);
+
+	src->vinfo = vinfo;
+	gst_spinnaker_src_setup_average (src);
+	gst_spinnaker_gate_clear (&src->gate);
+	if (src->gate_mode != GST_SPINNAKER_GATE_OFF && src->hdr_frames < 2)
+		gst_spinnaker_gate_init (&src->gate, src->nPitch, src->nHeight);
+	g_free (src->frame_scratch);
+	src->frame_scratch = NULL;
+	if (src->orient_sw || src->average_active)
+		src->frame_scratch = g_malloc ((gsize) src->nWidth * src->nHeight * GST_VIDEO_INFO_COMP_PSTRIDE (&vinfo, 0));
+	gst_spinnaker_src_setup_preview (src);
+	gst_spinnaker_src_setup_flat (src);
+	GList *roi_pads = gst_spinnaker_src_get_roi_pads (src);
+	for (GList *l = roi_pads; l; l = l->next)
+		gst_spinnaker_src_setup_roi_pad (src, l->data);
+	g_list_free_full (roi_pads, (GDestroyNotify) gst_spinnaker_src_aux_unref);
+
+	if (!gst_spinnaker_src_setup_ring (src, caps, vinfo.size))
+		goto fail;
+
+	gst_spinnaker_src_probe_latency (src);
+	gst_spinnaker_src_update_latency (src);
+
+	src->acq_started = TRUE;
+
+	return TRUE;
+
+	unsupported_caps:
+	GST_ERROR_OBJECT (src, "Unsupported caps: %" GST_PTR_FORMAT, caps);
+	return FALSE;
+
+	fail:
+	return FALSE;
+}
+
+// Stamps a captured frame. Timestamps are taken at capture time, so that
+// frames held back (e.g. in the pre-trigger ring) keep them when pushed later.
+// A frame that won't be pushed still takes its time, but no offset, and
+// leaves a pending discont to the next one.
+static void
+gst_spinnaker_src_timestamp (GstSpinnakerSrc * src, GstBuffer * buf, guint64 hw_timestamp, gboolean pushed)
+{
+	GstClock *clock;
+
+    src->duration = 1000000000.0/src->framerate; 
+	// If we do not use gst_base_src_set_do_timestamp() we need to add timestamps manually
+	src->last_frame_time += src->duration;   // Get the timestamp for this frame
+	if(!gst_base_src_get_do_timestamp(GST_BASE_SRC(src))){
+		GST_BUFFER_PTS(buf) = src->last_frame_time;  // convert ms to ns
+		GST_BUFFER_DTS(buf) = src->last_frame_time;  // convert ms to ns
+	} else if ((clock = gst_element_get_clock (GST_ELEMENT (src))) != NULL) {
+		GstClockTime now = gst_clock_get_time (clock);
+		GstClockTime base_time = gst_element_get_base_time (GST_ELEMENT (src));
+		GST_BUFFER_PTS(buf) = now > base_time ? now - base_time : 0;
+		GST_BUFFER_DTS(buf) = GST_BUFFER_PTS(buf);
+		gst_object_unref (clock);
+	}
+	GST_BUFFER_DURATION(buf) = src->duration;
+	GST_DEBUG_OBJECT(src, "pts, dts: %" GST_TIME_FORMAT ", duration: %d ms", GST_TIME_ARGS (GST_BUFFER_PTS(buf)), (gint) GST_TIME_AS_MSECONDS(src->duration));
+
+	// the camera's own clock, for recordings and pre-trigger analysis. Pool
+	// buffers keep the meta between uses so nothing is allocated per frame.
+	GstReferenceTimestampMeta *tmeta = gst_buffer_get_reference_timestamp_meta (buf, hw_timestamp_caps);
+	if (tmeta == NULL) {
+		tmeta = gst_buffer_add_reference_timestamp_meta (buf, hw_timestamp_caps, hw_timestamp, GST_CLOCK_TIME_NONE);
+		if (buf->pool)
+			GST_META_FLAG_SET ((GstMeta *) tmeta, GST_META_FLAG_POOLED | GST_META_FLAG_LOCKED);
+	}
+	tmeta->timestamp = hw_timestamp;
+
+	if (!pushed)
+		return;
+	if (src->discont) {
+		GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+		src->discont = FALSE;
+	}
+
+	GST_BUFFER_OFFSET(buf) = src->n_frames;  // from videotestsrc
+	src->n_frames++;
+	GST_BUFFER_OFFSET_END(buf) = src->n_frames;  // from videotestsrc
+}
+
+// Creates an extra src pad. It is sized for the frame by the streaming
+// thread, when it first comes across it.
+static GstSpinnakerAuxPad *
+gst_spinnaker_src_aux_pad_new (GstSpinnakerSrc * src, GstPadTemplate * templ,
+		const gchar * name, const gchar * stream_name)
+{
+	GstSpinnakerAuxPad *aux = g_new0 (GstSpinnakerAuxPad, 1);
+
+	aux->ref_count = 1;
+	aux->pad = gst_object_ref_sink (gst_pad_new_from_template (templ, name));
+	aux->stream_name = stream_name ? stream_name : GST_PAD_NAME (aux->pad);
+	gst_pad_use_fixed_caps (aux->pad);
+	gst_pad_set_active (aux->pad, TRUE);
+
+	return aux;
+}
+
+static GstSpinnakerAuxPad *
+gst_spinnaker_src_aux_ref (GstSpinnakerAuxPad * aux)
+{
+	g_atomic_int_inc (&aux->ref_count);
+	return aux;
+}
+
+// Frees the bookkeeping of a pad once it is off the element and no longer
+// being pushed on
+static void
+gst_spinnaker_src_aux_unref (GstSpinnakerAuxPad * aux)
+{
+	if (!g_atomic_int_dec_and_test (&aux->ref_count))
+		return;
+	gst_caps_replace (&aux->caps, NULL);
+	gst_object_unref (aux->pad);
+	g_free (aux);
+}
+
+static void
+gst_spinnaker_src_aux_pad_free (GstSpinnakerSrc * src, GstSpinnakerAuxPad * aux)
+{
+	gst_pad_set_active (aux->pad, FALSE);
+	gst_element_remove_pad (GST_ELEMENT (src), aux->pad);
+	gst_spinnaker_src_aux_unref (aux);
+}
+
+// The ROI pads, each with a reference, for the streaming thread to use
+// without holding the object lock
+static GList *
+gst_spinnaker_src_get_roi_pads (GstSpinnakerSrc * src)
+{
+	GList *pads = NULL, *l;
+
+	GST_OBJECT_LOCK (src);
+	for (l = src->roi_pads; l; l = l->next)
+		pads = g_list_prepend (pads, gst_spinnaker_src_aux_ref (l->data));
+	GST_OBJECT_UNLOCK (src);
+
+	return g_list_reverse (pads);
+}
+
+// The preview pad with a reference, NULL if there is none
+static GstSpinnakerAuxPad *
+gst_spinnaker_src_get_preview (GstSpinnakerSrc * src)
+{
+	GstSpinnakerAuxPad *aux;
+
+	GST_OBJECT_LOCK (src);
+	aux = src->preview ? gst_spinnaker_src_aux_ref (src->preview) : NULL;
+	GST_OBJECT_UNLOCK (src);
+
+	return aux;
+}
+
+// Sizes an ROI pad for the negotiated frame. Regions outside the frame get
+// no caps, and so no buffers.
+static void
+gst_spinnaker_src_setup_roi_pad (GstSpinnakerSrc * src, GstSpinnakerAuxPad * aux)
+{
+	GstSpinnakerRoi *roi;
+
+	aux->set_up = TRUE;
+	gst_caps_replace (&aux->caps, NULL);
+	gst_video_info_init (&aux->info);
+	if (GST_VIDEO_INFO_FORMAT (&src->vinfo) == GST_VIDEO_FORMAT_UNKNOWN)
+		return;
+
+	if (aux->roi >= src->rois->len) {
+		GST_WARNING_OBJECT (aux->pad, "no region %u in the rois property", aux->roi);
+		return;
+	}
+	roi = &g_array_index (src->rois, GstSpinnakerRoi, aux->roi);
+	if (roi->width == 0 || roi->height == 0 ||
+			roi->x + roi->width > GST_VIDEO_INFO_WIDTH (&src->vinfo) ||
+			roi->y + roi->height > GST_VIDEO_INFO_HEIGHT (&src->vinfo)) {
+		GST_WARNING_OBJECT (aux->pad, "region %u does not fit in the frame", aux->roi);
+		return;
+	}
+
+	gst_video_info_set_format (&aux->info, GST_VIDEO_INFO_FORMAT (&src->vinfo), roi->width, roi->height);
+	aux->info.fps_n = src->vinfo.fps_n;
+	aux->info.fps_d = src->vinfo.fps_d;
+	aux->caps = gst_video_info_to_caps (&aux->info);
+}
+
+static GstPad *
+gst_spinnaker_src_request_new_pad (GstElement * element, GstPadTemplate * templ,
+		const gchar * name, const GstCaps * caps)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (element);
+	GstElementClass *klass = GST_ELEMENT_GET_CLASS (element);
+	GstSpinnakerAuxPad *aux = NULL;
+	gboolean preview = FALSE, exists = FALSE;
+	gchar *pad_name;
+	guint index = 0;
+	GList *l;
+
+	// the lists are only held briefly by the streaming thread, which may
+	// itself be blocked downstream with the stream lock held
+	GST_OBJECT_LOCK (src);
+	if (templ == gst_element_class_get_pad_template (klass, "preview")) {
+		preview = TRUE;
+		if (src->preview == NULL) {
+			aux = gst_spinnaker_src_aux_pad_new (src, templ, "preview", "preview");
+			src->preview = aux;
+		} else {
+			exists = TRUE;
+		}
+	} else if (templ == gst_element_class_get_pad_template (klass, "roi_%u")) {
+		// roi_N is bound to the Nth region
+		if (name == NULL || sscanf (name, "roi_%u", &index) != 1) {
+			for (index = 0;; index++) {
+				for (l = src->roi_pads; l; l = l->next)
+					if (((GstSpinnakerAuxPad *) l->data)->roi == index)
+						break;
+				if (l == NULL)
+					break;
+			}
+		}
+		for (l = src->roi_pads; l; l = l->next)
+			if (((GstSpinnakerAuxPad *) l->data)->roi == index)
+				break;
+		if (l == NULL) {
+			pad_name = g_strdup_printf ("roi_%u", index);
+			aux = gst_spinnaker_src_aux_pad_new (src, templ, pad_name, NULL);
+			g_free (pad_name);
+			aux->roi = index;
+			src->roi_pads = g_list_append (src->roi_pads, aux);
+		} else {
+			exists = TRUE;
+		}
+	}
+	GST_OBJECT_UNLOCK (src);
+
+	if (exists && preview)
+		GST_WARNING_OBJECT (src, "there is only one preview pad");
+	else if (exists)
+		GST_WARNING_OBJECT (src, "pad roi_%u already exists", index);
+	if (aux == NULL)
+		return NULL;
+	gst_element_add_pad (element, aux->pad);
+	return aux->pad;
+}
+
+static void
+gst_spinnaker_src_release_pad (GstElement * element, GstPad * pad)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (element);
+	GstSpinnakerAuxPad *aux = NULL;
+	GList *l;
+
+	GST_OBJECT_LOCK (src);
+	if (src->preview && src->preview->pad == pad) {
+		aux = src->preview;
+		src->preview = NULL;
+	}
+	for (l = src->roi_pads; l && aux == NULL; l = l->next) {
+		if (((GstSpinnakerAuxPad *) l->data)->pad == pad) {
+			aux = l->data;
+			src->roi_pads = g_list_delete_link (src->roi_pads, l);
+			break;
+		}
+	}
+	GST_OBJECT_UNLOCK (src);
+
+	if (aux)
+		gst_spinnaker_src_aux_pad_free (src, aux);
+}
+
+static GstPadProbeReturn
+gst_spinnaker_src_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (user_data);
+	GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+	GList *pads = NULL, *l;
+
+	switch (GST_EVENT_TYPE (event)) {
+	case GST_EVENT_EOS:
+	case GST_EVENT_FLUSH_START:
+	case GST_EVENT_FLUSH_STOP:
+	case GST_EVENT_SEGMENT:
+		break;
+	default:
+		return GST_PAD_PROBE_OK;
+	}
+
+	// pads that haven't announced their stream yet will pick the segment up then
+	GST_OBJECT_LOCK (src);
+	if (src->preview && src->preview->started)
+		pads = g_list_prepend (pads, gst_object_ref (src->preview->pad));
+	for (l = src->roi_pads; l; l = l->next)
+		if (((GstSpinnakerAuxPad *) l->data)->started)
+			pads = g_list_prepend (pads, gst_object_ref (((GstSpinnakerAuxPad *) l->data)->pad));
+	GST_OBJECT_UNLOCK (src);
+
+	for (l = pads; l; l = l->next)
+		gst_pad_push_event (GST_PAD (l->data), gst_event_ref (event));
+	g_list_free_full (pads, gst_object_unref);
+
+	return GST_PAD_PROBE_OK;
+}
+
+// Sends whatever an extra pad still has to announce before its next buffer.
+// Returns TRUE if new caps went out.
+static gboolean
+gst_spinnaker_src_announce_aux (GstSpinnakerSrc * src, GstSpinnakerAuxPad * aux)
+{
+	gboolean new_caps = aux->caps != NULL;
+
+	if (!aux->started) {
+		gchar *stream_id = gst_pad_create_stream_id (aux->pad, GST_ELEMENT (src), aux->stream_name);
+		GstSegment segment;
+
+		gst_pad_push_event (aux->pad, gst_event_new_stream_start (stream_id));
+		g_free (stream_id);
+		if (aux->caps)
+			gst_pad_push_event (aux->pad, gst_event_new_caps (aux->caps));
+		gst_caps_replace (&aux->caps, NULL);
+
+		// the main pad only sends its segment after the first create()
+		GST_OBJECT_LOCK (src);
+		gst_segment_copy_into (&GST_BASE_SRC (src)->segment, &segment);
+		aux->started = TRUE;
+		GST_OBJECT_UNLOCK (src);
+		gst_pad_push_event (aux->pad, gst_event_new_segment (&segment));
+	} else if (aux->caps) {
+		gst_pad_push_event (aux->pad, gst_event_new_caps (aux->caps));
+		gst_caps_replace (&aux->caps, NULL);
+	}
+
+	return new_caps;
+}
+
+// Pushes a buffer on an extra pad. The extra pads are optional, so their
+// flow errors don't stop the main stream.
+static void
+gst_spinnaker_src_push_aux (GstSpinnakerSrc * src, GstSpinnakerAuxPad * aux, GstBuffer * buf)
+{
+	GstFlowReturn ret;
+
+	gst_spinnaker_src_announce_aux (src, aux);
+
+	ret = gst_pad_push (aux->pad, buf);
+	if (ret != GST_FLOW_OK && ret != GST_FLOW_NOT_LINKED && ret != GST_FLOW_FLUSHING)
+		GST_WARNING_OBJECT (aux->pad, "push failed: %s", gst_flow_get_name (ret));
+}
+
+// Whether the peer of an extra pad handles GstVideoMeta strides
+static gboolean
+gst_spinnaker_src_peer_has_video_meta (GstPad * pad)
+{
+	GstCaps *caps = gst_pad_get_current_caps (pad);
+	GstQuery *query;
+	gboolean ret;
+
+	if (caps == NULL)
+		return FALSE;
+	query = gst_query_new_allocation (caps, FALSE);
+	ret = gst_pad_peer_query (pad, query) &&
+			gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+	gst_query_unref (query);
+	gst_caps_unref (caps);
+
+	return ret;
+}
+
+// Pushes every ROI of a frame on its pad. A region is a sub-buffer sharing
+// the frame's memory, described by a GstVideoMeta carrying the frame's
+// stride. Only a peer that can't take the meta gets a packed copy, unless
+// the region's rows already have the packed stride.
+static void
+gst_spinnaker_src_push_rois (GstSpinnakerSrc * src, GstBuffer * buf)
+{
+	GList *pads = gst_spinnaker_src_get_roi_pads (src), *l;
+
+	for (l = pads; l; l = l->next) {
+		GstSpinnakerAuxPad *aux = l->data;
+		GstSpinnakerRoi *roi;
+		GstBuffer *sub;
+		GstVideoMeta *vmeta = gst_buffer_get_video_meta (buf);
+		gint stride = vmeta ? vmeta->stride[0] : GST_VIDEO_INFO_PLANE_STRIDE (&src->vinfo, 0);
+		gint pstride = GST_VIDEO_INFO_COMP_PSTRIDE (&src->vinfo, 0);
+		gsize offset, size;
+
+		// requested since the caps were set
+		if (!aux->set_up)
+			gst_spinnaker_src_setup_roi_pad (src, aux);
+		if (GST_VIDEO_INFO_FORMAT (&aux->info) == GST_VIDEO_FORMAT_UNKNOWN ||
+				!gst_pad_is_linked (aux->pad))
+			continue;
+
+		// both calls must run, check_reconfigure clears the flag
+		if (gst_spinnaker_src_announce_aux (src, aux) | gst_pad_check_reconfigure (aux->pad))
+			aux->video_meta = gst_spinnaker_src_peer_has_video_meta (aux->pad);
+
+		roi = &g_array_index (src->rois, GstSpinnakerRoi, aux->roi);
+		offset = roi->y * stride + roi->x * pstride;
+		size = (roi->height - 1) * stride + roi->width * pstride;
+
+		if (aux->video_meta || stride == GST_VIDEO_INFO_PLANE_STRIDE (&aux->info, 0)) {
+			sub = gst_buffer_copy_region (buf, GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS |
+					GST_BUFFER_COPY_META | GST_BUFFER_COPY_MEMORY, offset, size);
+			if (stride != GST_VIDEO_INFO_PLANE_STRIDE (&aux->info, 0)) {
+				gsize offsets[GST_VIDEO_MAX_PLANES] = { 0, };
+				gint strides[GST_VIDEO_MAX_PLANES] = { stride, };
+
+				gst_buffer_add_video_meta_full (sub, GST_VIDEO_FRAME_FLAG_NONE,
+						GST_VIDEO_INFO_FORMAT (&aux->info), roi->width, roi->height, 1, offsets, strides);
+			}
+		} else {
+			GstMapInfo in, out;
+			guint y;
+
+			sub = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&aux->info));
+			gst_buffer_copy_into (sub, buf, GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS |
+					GST_BUFFER_COPY_META, offset, size);
+			gst_buffer_map (buf, &in, GST_MAP_READ);
+			gst_buffer_map (sub, &out, GST_MAP_WRITE);
+			for (y = 0; y < roi->height; y++)
+				memcpy (out.data + y * GST_VIDEO_INFO_PLANE_STRIDE (&aux->info, 0),
+						in.data + offset + y * stride, roi->width * pstride);
+			gst_buffer_unmap (sub, &out);
+			gst_buffer_unmap (buf, &in);
+		}
+
+		gst_spinnaker_src_push_aux (src, aux, sub);
+	}
+	g_list_free_full (pads, (GDestroyNotify) gst_spinnaker_src_aux_unref);
+}
+
+// Sizes the preview for the negotiated frame and rate. HDR frames are
+// merged after the copy pass, so there is no preview of them.
+static void
+gst_spinnaker_src_setup_preview (GstSpinnakerSrc * src)
+{
+	guint width = src->nWidth / src->preview_scale;
+	guint height = src->nHeight / src->preview_scale;
+	GstSpinnakerAuxPad *aux;
+
+	g_free (src->preview_acc);
+	src->preview_acc = NULL;
+	g_free (src->preview_scratch);
+	src->preview_scratch = NULL;
+	if (width == 0 || height == 0 || src->hdr_active)
+		return;
+	src->preview_width = width;
+	src->preview_height = height;
+	// the preview is filtered from unoriented rows, then oriented as a whole
+	if (src->orient_sw)
+		src->preview_scratch = g_malloc ((gsize) width * height);
+
+	src->preview_interval = 1;
+	if (src->preview_rate > 0.0 && src->framerate > src->preview_rate)
+		src->preview_interval = (guint) ceil (src->framerate / src->preview_rate);
+
+	gst_video_info_set_format (&src->preview_info, GST_VIDEO_FORMAT_GRAY8,
+			src->orient.transpose ? height : width, src->orient.transpose ? width : height);
+	gst_util_double_to_fraction (src->framerate / src->preview_interval,
+			&src->preview_info.fps_n, &src->preview_info.fps_d);
+	src->preview_acc = g_new0 (guint32, (gsize) width * gst_spinnaker_workers_get_n_threads (src->workers));
+
+	// a pad requested later is set up when first used
+	aux = gst_spinnaker_src_get_preview (src);
+	if (aux) {
+		gst_caps_take (&aux->caps, gst_video_info_to_caps (&src->preview_info));
+		aux->set_up = TRUE;
+		gst_spinnaker_src_aux_unref (aux);
+	}
+	GST_INFO_OBJECT (src, "preview %ux%u, every %u frames", width, height, src->preview_interval);
+}
+
+// The preview pad, with a reference, if this frame gets a preview
+static GstSpinnakerAuxPad *
+gst_spinnaker_src_want_preview (GstSpinnakerSrc * src)
+{
+	GstSpinnakerAuxPad *aux;
+
+	if (src->preview_acc == NULL || (aux = gst_spinnaker_src_get_preview (src)) == NULL)
+		return NULL;
+	// requested since the caps were set
+	if (!aux->set_up) {
+		gst_caps_take (&aux->caps, gst_video_info_to_caps (&src->preview_info));
+		aux->set_up = TRUE;
+	}
+	if (!gst_pad_is_linked (aux->pad) || src->preview_count++ % src->preview_interval != 0) {
+		gst_spinnaker_src_aux_unref (aux);
+		return NULL;
+	}
+	return aux;
+}
+
+// Adds one row to the preview's box filter and writes a preview row once
+// preview_scale rows are in. Pixels that don't fill a whole box are dropped.
+// acc is the column sums of the band the row belongs to.
+static inline void
+gst_spinnaker_src_row_preview (GstSpinnakerSrc * src, guint32 *acc, const guint8 *row,
+		unsigned int y, guint8 *out, guint out_stride)
+{
+	guint scale = src->preview_scale;
+	guint width = src->preview_width;
+	guint x = 0, k;
+
+	if (y / scale >= src->preview_height)
+		return;
+
+#ifdef __SSE2__
+	// psadbw against zero sums eight bytes at once
+	if (scale == 8) {
+		const __m128i zero = _mm_setzero_si128 ();
+		for (; x + 2 <= width; x += 2) {
+			__m128i sad = _mm_sad_epu8 (_mm_loadu_si128 ((const __m128i *) (row + x * 8)), zero);
+			acc[x] += _mm_cvtsi128_si32 (sad);
+			acc[x + 1] += _mm_cvtsi128_si32 (_mm_srli_si128 (sad, 8));
+		}
+	} else if (scale == 16) {
+		const __m128i zero = _mm_setzero_si128 ();
+		for (; x < width; x++) {
+			__m128i sad = _mm_sad_epu8 (_mm_loadu_si128 ((const __m128i *) (row + x * 16)), zero);
+			acc[x] += _mm_cvtsi128_si32 (sad) + _mm_cvtsi128_si32 (_mm_srli_si128 (sad, 8));
+		}
+	}
+#endif
+	for (; x < width; x++) {
+		const guint8 *p = row + x * scale;
+		guint32 sum = 0;
+		for (k = 0; k < scale; k++)
+			sum += p[k];
+		acc[x] += sum;
+	}
+
+	if (y % scale == scale - 1) {
+		guint8 *dst = out + (y / scale) * out_stride;
+		guint area = scale * scale;
+		for (x = 0; x < width; x++) {
+			dst[x] = (acc[x] + area / 2) / area;
+			acc[x] = 0;
+		}
+	}
+}
+
+// Gives a camera that came back the configuration it had, and restarts it
+static gboolean
+gst_spinnaker_src_reopen_camera (GstSpinnakerSrc * src, spinCamera hCamera)
+{
+	if (!gst_spinnaker_src_open_camera (src, hCamera, TRUE))
+		goto fail;
+	// exposure and gain as last used, set by a property or by the exposure loop
+	src->exposure_just_changed = TRUE;
+	src->gain_just_changed = TRUE;
+	gst_spinnaker_src_apply_exposure (src);
+	if (!gst_spinnaker_src_setup_sequencer (src, src->hNodeMap) ||
+			!gst_spinnaker_src_apply_framerate (src, &src->vinfo))
+		goto fail;
+	EXEANDCHECK(spinCameraBeginAcquisition(hCamera));
+	return TRUE;
+
+	fail:
+	gst_spinnaker_src_close_camera (src);
+	return FALSE;
+}
+
+// Moves the timestamps past the frames the camera would have captured in
+// elapsed us, skipped of them are already. With reconnect=gap they are
+// announced downstream with a GAP event. Returns the frames skipped now.
+static guint64
+gst_spinnaker_src_skip_frames (GstSpinnakerSrc * src, gint64 elapsed, guint64 skipped)
+{
+	guint64 due = src->framerate > 0.0 ? (guint64) (elapsed * src->framerate / G_USEC_PER_SEC) : 0;
+	GstClockTime duration, pts;
+	GstClock *clock;
+
+	if (due <= skipped)
+		return skipped;
+
+	duration = (due - skipped) * (GstClockTime) (1000000000.0 / src->framerate);
+	pts = src->last_frame_time + 1000000000.0 / src->framerate;
+	src->last_frame_time += duration;
+	if (gst_base_src_get_do_timestamp (GST_BASE_SRC (src)) &&
+			(clock = gst_element_get_clock (GST_ELEMENT (src))) != NULL) {
+		GstClockTime now = gst_clock_get_time (clock) - gst_element_get_base_time (GST_ELEMENT (src));
+		pts = now > duration ? now - duration : 0;
+		gst_object_unref (clock);
+	}
+
+	// nothing can go before the first frame's segment
+	if (src->reconnect == GST_SPINNAKER_RECONNECT_GAP && src->n_frames > 0)
+		gst_pad_push_event (GST_BASE_SRC_PAD (src), gst_event_new_gap (pts, duration));
+	return due;
+}
+
+// Waits for the camera to come back after grabbing failed and restarts it
+// as it was. The camera list is enumerated again on every arrival event,
+// and every GRAB_TIMEOUT_MS for cameras whose arrival isn't reported.
+static GstFlowReturn
+gst_spinnaker_src_reconnect (GstSpinnakerSrc * src)
+{
+	gint64 start = g_get_monotonic_time ();
+	gint64 now;
+	guint64 skipped = 0;
+	spinCamera hCamera;
+	GstClockTime outage;
+	guint reconnects;
+
+	GST_ELEMENT_WARNING (src, RESOURCE, READ, ("Lost camera %s, waiting for it to come back", src->camera_serial), (NULL));
+	// a flush may have ended an earlier wait
+	if (src->hCamera)
+		gst_spinnaker_src_close_camera (src);
+	gst_spinnaker_src_hdr_clear (src);
+
+	for (;;) {
+		GST_OBJECT_LOCK (src);
+		if (src->unlocking) {
+			GST_OBJECT_UNLOCK (src);
+			return GST_FLOW_FLUSHING;
+		}
+		GST_OBJECT_UNLOCK (src);
+
+		hCamera = NULL;
+		spinCameraListClear(src->hCameraList);
+		if (spinSystemGetCameras(src->hSystem, src->hCameraList) == SPINNAKER_ERR_SUCCESS &&
+				spinCameraListGetBySerial(src->hCameraList, src->camera_serial, &hCamera) == SPINNAKER_ERR_SUCCESS &&
+				hCamera && gst_spinnaker_src_reopen_camera (src, hCamera))
+			break;
+
+		now = g_get_monotonic_time ();
+		skipped = gst_spinnaker_src_skip_frames (src, now - start, skipped);
+		if (src->reconnect_timeout && now - start >= (gint64) src->reconnect_timeout * 1000) {
+			GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND,
+					("Camera %s did not come back within %u ms.", src->camera_serial, src->reconnect_timeout), (NULL));
+			return GST_FLOW_ERROR;
+		}
+
+		g_mutex_lock (&src->reconnect_lock);
+		if (!src->camera_arrived)
+			g_cond_wait_until (&src->reconnect_cond, &src->reconnect_lock, now + GRAB_TIMEOUT_MS * 1000);
+		src->camera_arrived = FALSE;
+		g_mutex_unlock (&src->reconnect_lock);
+	}
+
+	now = g_get_monotonic_time ();
+	gst_spinnaker_src_skip_frames (src, now - start, skipped);
+	g_atomic_int_set (&src->camera_lost, 0);
+	src->discont = TRUE;
+
+	outage = (now - start) * GST_USECOND;
+	GST_OBJECT_LOCK (src);
+	reconnects = ++src->reconnects;
+	src->outage_last = outage;
+	src->outage_total += outage;
+	GST_OBJECT_UNLOCK (src);
+
+	GST_INFO_OBJECT (src, "camera %s back after %" GST_TIME_FORMAT, src->camera_serial, GST_TIME_ARGS (outage));
+	gst_element_post_message (GST_ELEMENT (src), gst_message_new_element (GST_OBJECT (src),
+			gst_structure_new ("spinnaker-reconnect",
+				"serial", G_TYPE_STRING, src->camera_serial,
+				"reconnects", G_TYPE_UINT, reconnects,
+				"outage", G_TYPE_UINT64, outage, NULL)));
+	return GST_FLOW_OK;
+}
+
+// Waits for the next image, giving up when the element is being unlocked
+static GstFlowReturn
+gst_spinnaker_src_grab (GstSpinnakerSrc * src, spinImage *hResultImage)
+{
+	spinError err;
+	GstFlowReturn ret;
+
+	for (;;) {
+		GST_OBJECT_LOCK (src);
+		if (src->unlocking) {
+			GST_OBJECT_UNLOCK (src);
+			return GST_FLOW_FLUSHING;
+		}
+		GST_OBJECT_UNLOCK (src);
+
+		err = spinCameraGetNextImageEx(src->hCamera, GRAB_TIMEOUT_MS, hResultImage);
+		if (err == SPINNAKER_ERR_SUCCESS)
+			return GST_FLOW_OK;
+		if (err == SPINNAKER_ERR_TIMEOUT) {
+			src->total_timeouts++;
+			if (!g_atomic_int_get (&src->camera_lost))
+				continue;
+		}
+		if (src->camera_serial == NULL)
+			break;
+		GST_WARNING_OBJECT (src, "grabbing failed with %d, reconnecting", err);
+		ret = gst_spinnaker_src_reconnect (src);
+		if (ret != GST_FLOW_OK)
+			return ret;
+	}
+	EXEANDCHECK(err);
+
+	return GST_FLOW_OK;
+
+	fail:
+	return GST_FLOW_ERROR;
+}
+
+// Drops the frames collected for the current HDR bracket
+static void
+gst_spinnaker_src_hdr_clear (GstSpinnakerSrc * src)
+{
+	guint i;
+
+	for (i = 0; i < GST_SPINNAKER_HDR_MAX_FRAMES; i++) {
+		if (src->hdr_images[i])
+			spinImageDestroy(src->hdr_images[i]);
+		src->hdr_images[i] = NULL;
+	}
+	src->hdr_next = 0;
+}
+
+// Keeps a copy of a frame for the current bracket. Returns TRUE once the
+// bracket is complete; the image is owned by the bracket either way.
+static gboolean
+gst_spinnaker_src_hdr_store (GstSpinnakerSrc * src, spinImage hResultImage,
+		spinImage hConvertedImage, guint64 hw_timestamp)
+{
+	int64_t set = src->hdr_next;
+
+	if (src->hdr_chunk &&
+			spinImageChunkDataGetIntValue(hResultImage, "ChunkSequencerSetActive", &set) != SPINNAKER_ERR_SUCCESS)
+		set = src->hdr_next;
+
+	// a lost frame breaks the bracket, start over at the next first set
+	if (set != src->hdr_next) {
+		GST_WARNING_OBJECT (src, "expected sequencer set %u, got %" G_GINT64_FORMAT ", dropping bracket",
+				src->hdr_next, (gint64) set);
+		gst_spinnaker_src_hdr_clear (src);
+		if (set != 0) {
+			spinImageDestroy(hConvertedImage);
+			return FALSE;
+		}
+	}
+
+	if (set == 0)
+		src->hdr_timestamp = hw_timestamp;
+	src->hdr_images[set] = hConvertedImage;
+	src->hdr_next = set + 1;
+
+	return src->hdr_next == src->hdr_frames;
+}
+
+static void
+gst_spinnaker_src_hdr_job (guint job, guint n_jobs, gpointer user_data)
+{
+	GstSpinnakerHdrMerge *merge = user_data;
+	guint first = merge->height * job / n_jobs;
+	guint last = merge->height * (job + 1) / n_jobs;
+
+	gst_spinnaker_hdr_merge_rows (merge, first, last - first);
+}
+
+// Fuses the completed bracket into the mapped output frame, one band of
+// rows per worker, then releases the bracket
+static void
+gst_spinnaker_src_hdr_merge (GstSpinnakerSrc * src, guint8 * out, guint out_stride)
+{
+	GstSpinnakerHdrMerge *merge = &src->hdr_merge;
+	void *data;
+	size_t stride;
+	guint i;
+
+	for (i = 0; i < src->hdr_frames; i++) {
+		spinImageGetData(src->hdr_images[i], &data);
+		merge->planes[i] = data;
+	}
+	if (spinImageGetStride(src->hdr_images[0], &stride) != SPINNAKER_ERR_SUCCESS)
+		stride = (size_t) src->nWidth * (merge->in_bits > 8 ? 2 : 1);
+	merge->in_stride = stride;
+	merge->out = out;
+	merge->out_stride = out_stride;
+	merge->width = src->nWidth;
+	merge->height = src->nHeight;
+
+	gst_spinnaker_workers_run (src->workers, gst_spinnaker_workers_get_n_threads (src->workers),
+			gst_spinnaker_src_hdr_job, merge);
+
+	gst_spinnaker_src_hdr_clear (src);
+}
+
+static void
+gst_spinnaker_src_flat_free (GstSpinnakerSrc * src)
+{
+	g_free (src->dark_map);
+	src->dark_map = NULL;
+	g_free (src->flat_map);
+	src->flat_map = NULL;
+	g_free (src->flat_gain);
+	src->flat_gain = NULL;
+	g_free (src->calib_acc);
+	src->calib_acc = NULL;
+	src->calib = GST_SPINNAKER_CALIBRATION_NONE;
+}
+
+static void
+gst_spinnaker_src_flat_update_gain (GstSpinnakerSrc * src)
+{
+	g_free (src->flat_gain);
+	src->flat_gain = NULL;
+	if (src->flat_map == NULL)
+		return;
+	src->flat_gain = g_new (guint16, (gsize) src->flat_width * src->flat_height);
+	gst_spinnaker_flat_compute_gain (src->flat_gain, src->flat_map, src->dark_map,
+			(gsize) src->flat_width * src->flat_height);
+}
+
+// Loads a map if its file is set. A map that can't be used is reported and
+// the one in use, if any, is kept.
+static void
+gst_spinnaker_src_flat_load (GstSpinnakerSrc * src, const gchar * location, guint16 ** map)
+{
+	GError *error = NULL;
+	guint width, height;
+	guint16 *loaded;
+
+	if (location == NULL)
+		return;
+
+	loaded = gst_spinnaker_flat_load_pgm (location, &width, &height, &error);
+	if (loaded == NULL) {
+		GST_ELEMENT_WARNING (src, RESOURCE, READ, ("Unable to load %s", location), ("%s", error->message));
+		g_error_free (error);
+		return;
+	}
+	if (width != src->nWidth || height != src->nHeight) {
+		GST_ELEMENT_WARNING (src, RESOURCE, READ, ("Unable to use %s", location),
+				("map is %ux%u, frames are %ux%u", width, height, src->nWidth, src->nHeight));
+		g_free (loaded);
+		return;
+	}
+	g_free (*map);
+	*map = loaded;
+	GST_INFO_OBJECT (src, "loaded %s", location);
+}
+
+// Loads the correction maps for the negotiated size. Maps captured earlier
+// are kept as long as the size doesn't change.
+static void
+gst_spinnaker_src_setup_flat (GstSpinnakerSrc * src)
+{
+	if (src->flat_width != src->nWidth || src->flat_height != src->nHeight) {
+		if (src->dark_map || src->flat_map)
+			GST_WARNING_OBJECT (src, "frame size changed, dropping the captured correction maps");
+		gst_spinnaker_src_flat_free (src);
+		src->flat_width = src->nWidth;
+		src->flat_height = src->nHeight;
+	}
+
+	gst_spinnaker_src_flat_load (src, src->dark_location, &src->dark_map);
+	gst_spinnaker_src_flat_load (src, src->flat_location, &src->flat_map);
+	gst_spinnaker_src_flat_update_gain (src);
+
+	if (src->hdr_active && (src->dark_map || src->flat_gain || src->blacklevel > 0))
+		GST_WARNING_OBJECT (src, "flat-field correction has no effect on HDR frames");
+}
+
+static gboolean
+gst_spinnaker_src_want_flat (GstSpinnakerSrc * src)
+{
+	return !src->hdr_active && (src->dark_map || src->flat_gain || src->blacklevel > 0 ||
+			src->calib != GST_SPINNAKER_CALIBRATION_NONE ||
+			src->calib_request != GST_SPINNAKER_CALIBRATION_NONE);
+}
+
+// Bits per pixel of the formats the correction reads without converting
+// them first, 0 for the others
+static guint
+gst_spinnaker_src_raw_bits (spinImage hImage)
+{
+	spinPixelFormatEnums format;
+
+	if (spinImageGetPixelFormat(hImage, &format) != SPINNAKER_ERR_SUCCESS)
+		return 0;
+	switch (format) {
+	case PixelFormat_Mono8:
+		return 8;
+	case PixelFormat_Mono10:
+		return 10;
+	case PixelFormat_Mono12:
+		return 12;
+	case PixelFormat_Mono14:
+		return 14;
+	case PixelFormat_Mono16:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+static void
+gst_spinnaker_src_capture_dark (GstSpinnakerSrc * src, guint n_frames)
+{
+	GST_DEBUG_OBJECT (src, "capture-dark %u", n_frames);
+	GST_OBJECT_LOCK (src);
+	src->calib_request = GST_SPINNAKER_CALIBRATION_DARK;
+	src->calib_request_frames = CLAMP (n_frames, 1, MAX_CALIBRATION_FRAMES);
+	GST_OBJECT_UNLOCK (src);
+}
+
+static void
+gst_spinnaker_src_capture_flat (GstSpinnakerSrc * src, guint n_frames)
+{
+	GST_DEBUG_OBJECT (src, "capture-flat %u", n_frames);
+	GST_OBJECT_LOCK (src);
+	src->calib_request = GST_SPINNAKER_CALIBRATION_FLAT;
+	src->calib_request_frames = CLAMP (n_frames, 1, MAX_CALIBRATION_FRAMES);
+	GST_OBJECT_UNLOCK (src);
+}
+
+// Turns the sums of a finished calibration into a map, puts it in use,
+// saves it and tells the application
+typedef struct
+{
+	GstSpinnakerSrc *src;
+	gchar *location;
+	guint16 *map;
+	guint width, height;
+	guint frames;
+	gboolean dark;
+} GstSpinnakerCalibrationSave;
+
+// Writes a finished map on a thread of its own, so the streaming thread
+// doesn't wait on the disk, and only then tells the application about it
+static gpointer
+gst_spinnaker_src_calibration_save (gpointer data)
+{
+	GstSpinnakerCalibrationSave *save = data;
+	GstSpinnakerSrc *src = save->src;
+	GError *error = NULL;
+
+	if (save->location &&
+			!gst_spinnaker_flat_save_pgm (save->location, save->map, save->width, save->height, &error)) {
+		GST_ELEMENT_WARNING (src, RESOURCE, WRITE, ("Unable to save %s", save->location), ("%s", error->message));
+		g_error_free (error);
+	}
+
+	gst_element_post_message (GST_ELEMENT (src), gst_message_new_element (GST_OBJECT (src),
+			gst_structure_new ("spinnaker-calibration",
+					"map", G_TYPE_STRING, save->dark ? "dark" : "flat",
+					"frames", G_TYPE_UINT, save->frames,
+					"location", G_TYPE_STRING, save->location, NULL)));
+
+	gst_object_unref (src);
+	g_free (save->location);
+	g_free (save->map);
+	g_free (save);
+	return NULL;
+}
+
+static void
+gst_spinnaker_src_calibration_done (GstSpinnakerSrc * src)
+{
+	gsize i, n = (gsize) src->flat_width * src->flat_height;
+	guint16 *map = g_new (guint16, n);
+	gboolean dark = src->calib == GST_SPINNAKER_CALIBRATION_DARK;
+	const gchar *location = dark ? src->dark_location : src->flat_location;
+	GstSpinnakerCalibrationSave *save;
+
+	for (i = 0; i < n; i++)
+		map[i] = (guint16) ((src->calib_acc[i] + src->calib_frames / 2) / src->calib_frames);
+	g_free (src->calib_acc);
+	src->calib_acc = NULL;
+	src->calib = GST_SPINNAKER_CALIBRATION_NONE;
+
+	if (dark) {
+		g_free (src->dark_map);
+		src->dark_map = map;
+	} else {
+		g_free (src->flat_map);
+		src->flat_map = map;
+	}
+	// the gain depends on both maps
+	gst_spinnaker_src_flat_update_gain (src);
+	GST_INFO_OBJECT (src, "%s map averaged from %u frames", dark ? "dark" : "flat", src->calib_frames);
+
+	// the map in use may be replaced before the write is done
+	save = g_new0 (GstSpinnakerCalibrationSave, 1);
+	save->src = gst_object_ref (src);
+	save->location = g_strdup (location);
+	save->map = g_new (guint16, n);
+	memcpy (save->map, map, n * sizeof (guint16));
+	save->width = src->flat_width;
+	save->height = src->flat_height;
+	save->frames = src->calib_frames;
+	save->dark = dark;
+	g_thread_unref (g_thread_new ("spinnakercalib", gst_spinnaker_src_calibration_save, save));
+}
+
+// Whether frames are worth splitting across the workers
+static gboolean
+gst_spinnaker_src_banded (GstSpinnakerSrc * src)
+{
+	return gst_spinnaker_workers_get_n_threads (src->workers) > 1 &&
+			(gsize) src->nWidth * src->nHeight >= BAND_THREAD_PIXELS;
+}
+
+static void
+gst_spinnaker_src_flat_job (guint job, guint n_jobs, gpointer user_data)
+{
+	GstSpinnakerFlatField *ff = user_data;
+	guint first = ff->height * job / n_jobs;
+	guint last = ff->height * (job + 1) / n_jobs;
+
+	gst_spinnaker_flat_correct_rows (ff, first, last - first);
+}
+
+static void
+gst_spinnaker_src_shift_job (guint job, guint n_jobs, gpointer user_data)
+{
+	GstSpinnakerFlatField *ff = user_data;
+	guint first = ff->height * job / n_jobs;
+	guint last = ff->height * (job + 1) / n_jobs;
+
+	gst_spinnaker_flat_shift_rows (ff, first, last - first);
+}
+
+// Converts a deeper mono frame to 8 bits as the SDK would, in bands of
+// rows across the workers rather than on this thread alone
+static void
+gst_spinnaker_src_convert (GstSpinnakerSrc * src, const void *data, gsize stride,
+		guint bits, guint8 * out, guint out_stride)
+{
+	GstSpinnakerFlatField ff = { 0, };
+
+	ff.in = data;
+	ff.in_stride = stride;
+	ff.in_bits = bits;
+	ff.out = out;
+	ff.out_stride = out_stride;
+	ff.width = src->nWidth;
+	ff.height = src->nHeight;
+	gst_spinnaker_workers_run (src->workers, gst_spinnaker_workers_get_n_threads (src->workers),
+			gst_spinnaker_src_shift_job, &ff);
+}
+
+// Corrects a frame into the mapped output buffer, converting it to 8 bits
+// on the way. Large frames are split in bands of rows across the workers.
+// Without any correction to apply this is just the conversion.
+// The input is also summed while a calibration is running.
+static void
+gst_spinnaker_src_flat_correct (GstSpinnakerSrc * src, const void *data, gsize stride,
+		guint bits, guint8 * out, guint out_stride)
+{
+	GstSpinnakerFlatField *ff = &src->flat;
+
+	if (src->calib == GST_SPINNAKER_CALIBRATION_NONE) {
+		GST_OBJECT_LOCK (src);
+		src->calib = src->calib_request;
+		src->calib_frames = src->calib_request_frames;
+		src->calib_request = GST_SPINNAKER_CALIBRATION_NONE;
+		GST_OBJECT_UNLOCK (src);
+		if (src->calib != GST_SPINNAKER_CALIBRATION_NONE) {
+			src->calib_acc = g_new0 (guint32, (gsize) src->flat_width * src->flat_height);
+			src->calib_count = 0;
+		}
+	}
+
+	ff->in = data;
+	ff->in_stride = stride;
+	ff->in_bits = bits;
+	ff->dark = src->dark_map;
+	ff->gain = src->flat_gain;
+	ff->offset = (guint16) (src->blacklevel << 8);
+	ff->acc = src->calib_acc;
+	ff->out = out;
+	ff->out_stride = out_stride;
+	ff->width = src->nWidth;
+	ff->height = src->nHeight;
+
+	if (gst_spinnaker_src_banded (src))
+		gst_spinnaker_workers_run (src->workers, gst_spinnaker_workers_get_n_threads (src->workers),
+				gst_spinnaker_src_flat_job, ff);
+	else
+		gst_spinnaker_flat_correct_rows (ff, 0, ff->height);
+
+	if (src->calib != GST_SPINNAKER_CALIBRATION_NONE && ++src->calib_count == src->calib_frames)
+		gst_spinnaker_src_calibration_done (src);
+}
+
+static void
+gst_spinnaker_src_average_free (GstSpinnakerSrc * src)
+{
+	g_free (src->average_sum);
+	src->average_sum = NULL;
+	g_free (src->average_acc);
+	src->average_acc = NULL;
+	g_free (src->average_out);
+	src->average_out = NULL;
+	src->average_active = FALSE;
+}
+
+// Camera frames per pushed frame in block mode, 1 otherwise. HDR frames
+// are not averaged.
+static guint
+gst_spinnaker_src_average_block (GstSpinnakerSrc * src)
+{
+	if (src->hdr_frames >= 2 || src->average_frames < 2 || src->average_mode != GST_SPINNAKER_AVERAGE_BLOCK)
+		return 1;
+	return src->average_frames;
+}
+
+// Preallocates the accumulator for the negotiated size, so averaging
+// allocates nothing per frame
+static void
+gst_spinnaker_src_setup_average (GstSpinnakerSrc * src)
+{
+	gsize n = (gsize) src->nWidth * src->nHeight;
+
+	gst_spinnaker_src_average_free (src);
+	src->average_count = 0;
+	if (src->average_frames < 2)
+		return;
+	if (src->hdr_frames >= 2) {
+		GST_WARNING_OBJECT (src, "average-frames has no effect on HDR frames");
+		return;
+	}
+
+	if (src->average_mode == GST_SPINNAKER_AVERAGE_BLOCK) {
+		src->average_sum = g_new0 (guint16, n);
+	} else {
+		src->average_shift = (guint) floor (log2 (src->average_frames) + 0.5);
+		if (1u << src->average_shift != src->average_frames)
+			GST_INFO_OBJECT (src, "running average weighs new frames by 1/%u", 1u << src->average_shift);
+		src->average_acc = g_new (guint32, n);
+	}
+	src->average_out = g_malloc (n);
+	src->average_active = TRUE;
+}
+
+// Adds a row of the current frame to the average. Returns the averaged row
+// to push, NULL while a block is still being summed.
+static inline const guint8 *
+gst_spinnaker_src_average_row (GstSpinnakerSrc * src, const guint8 * row, guint y, gboolean emit)
+{
+	gsize offset = (gsize) y * src->nWidth;
+	guint8 *out = emit ? src->average_out + offset : NULL;
+
+	if (src->average_mode == GST_SPINNAKER_AVERAGE_BLOCK)
+		gst_spinnaker_average_block_row (src->average_sum + offset, row, src->nWidth, src->average_frames, out);
+	else
+		gst_spinnaker_average_recursive_row (src->average_acc + offset, row, src->nWidth,
+				src->average_shift, src->average_count == 0, out);
+	return out;
+}
+
+// Whether the frame just compared is pushed: some block changed, or
+// nothing was pushed for gate-keepalive. It is then the new reference.
+static gboolean
+gst_spinnaker_src_gate_pass (GstSpinnakerSrc * src)
+{
+	gdouble change = gst_spinnaker_gate_change (&src->gate);
+	gint64 now = g_get_monotonic_time ();
+
+	if (change < src->gate_threshold && (src->gate_keepalive == 0 ||
+			now - src->gate_last_push < (gint64) src->gate_keepalive * 1000)) {
+		GST_LOG_OBJECT (src, "frame unchanged, blocks differ by %f at most", change);
+		return FALSE;
+	}
+	gst_spinnaker_gate_accept (&src->gate);
+	src->gate_last_push = now;
+	return TRUE;
+}
+
+// Moves the streaming thread to the first CPU of cpu-affinity and to the
+// scheduling asked for. This is done before it allocates or first writes
+// any frame memory: Linux puts pages on the NUMA node of the CPU touching
+// them first, so pools, scratch frames and accumulators stay on the node
+// the frames are processed on.
+static void
+gst_spinnaker_src_setup_streaming_thread (GstSpinnakerSrc * src)
+{
+	GThread *self = g_thread_self ();
+
+	if (src->streaming_thread == self)
+		return;
+	src->streaming_thread = self;
+	if (src->thread_config.cpus == NULL && src->thread_config.scheduling == GST_SPINNAKER_SCHEDULING_NORMAL)
+		return;
+
+	gst_spinnaker_thread_restore (src->streaming_state);
+	src->streaming_state = gst_spinnaker_thread_save ();
+	if (!gst_spinnaker_thread_setup (&src->thread_config, src->thread_config.cpus ? src->thread_config.cpus[0] : -1))
+		GST_WARNING_OBJECT (src, "the streaming thread can't be pinned or scheduled as asked, running it as it is");
+}
+
+// Gives the streaming thread back as it was, once it stops streaming for
+// us; it is a pooled thread other tasks may run on next
+static void
+gst_spinnaker_src_release_streaming_thread (GstSpinnakerSrc * src)
+{
+	if (src->streaming_thread != g_thread_self ())
+		return;
+	gst_spinnaker_thread_restore (src->streaming_state);
+	src->streaming_state = NULL;
+	src->streaming_thread = NULL;
+}
+
+// Gets a buffer for a frame laid out with the negotiated stride, from the
+// pool if there is one. Returns FALSE if the pool is exhausted.
+static gboolean
+gst_spinnaker_src_alloc_frame (GstSpinnakerSrc * src, GstBufferPool * pool, GstBuffer ** buf)
+{
+	GstBufferPoolAcquireParams params = { 0, };
+
+	if (pool == NULL) {
+		*buf = gst_buffer_new_allocate (src->allocator, GST_VIDEO_INFO_HEIGHT (&src->vinfo) * src->gst_stride,
+				&src->alloc_params);
+		return TRUE;
+	}
+
+	params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+	if (gst_buffer_pool_acquire_buffer (pool, buf, &params) != GST_FLOW_OK) {
+		GST_WARNING_OBJECT (src, "no free buffer in the pool, dropping frame");
+		*buf = NULL;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+// One frame's pass over its rows: copy out, statistics, preview, averaging
+// and gating. Bands are whole multiples of unit rows, so oriented copies,
+// preview boxes and gate blocks never straddle two bands.
+typedef struct
+{
+	GstSpinnakerSrc *src;
+	const guint8 *data;         // the frame as captured or corrected
+	gsize stride;
+	const guint8 *out_data;     // the frame pushed, the average when averaging
+	gsize out_stride;
+	guint8 *out;                // mapped buffer, NULL when nothing is copied
+	guint8 *pout;               // preview, NULL for none
+	guint pstride;
+	gboolean want_stats;
+	gboolean want_focus;
+	gboolean average;
+	gboolean emit;
+	gboolean gate;              // compare the rows pushed with the last frame pushed
+	guint unit;
+} GstSpinnakerRowPass;
+
+static void
+gst_spinnaker_src_row_job (guint job, guint n_jobs, gpointer user_data)
+{
+	GstSpinnakerRowPass *pass = user_data;
+	GstSpinnakerSrc *src = pass->src;
+	GstSpinnakerFrameStats *stats = &src->band_stats[job];
+	guint32 *acc = pass->pout ? src->preview_acc + (gsize) job * src->preview_width : NULL;
+	guint units = (src->nHeight + pass->unit - 1) / pass->unit;
+	guint first = units * job / n_jobs * pass->unit;
+	guint last = MIN (units * (job + 1) / n_jobs * pass->unit, src->nHeight);
+	guint i;
+
+	if (pass->want_stats)
+		memset (stats, 0, sizeof (*stats));
+	for (i = first; i < last; i++) {
+		const guint8 *row = pass->data + i * pass->stride;
+		const guint8 *out_row = pass->average ? gst_spinnaker_src_average_row (src, row, i, pass->emit) : row;
+		// oriented copies go a band of rows at a time, while the band is in cache
+		if (pass->out && !src->orient_sw)
+			memcpy (pass->out + i * src->gst_stride, out_row, src->nPitch);
+		else if (pass->out && (i % ORIENT_BAND == ORIENT_BAND - 1 || i == src->nHeight - 1))
+			gst_spinnaker_orient_rows (&src->orient, pass->out_data, pass->out_stride, src->nWidth, src->nHeight, 1,
+					i - i % ORIENT_BAND, i % ORIENT_BAND + 1, pass->out, src->gst_stride);
+		if (pass->want_stats)
+			gst_spinnaker_src_row_stats (stats, row, src->nWidth);
+		if (pass->want_focus && i > 0) {
+			stats->focus_sum += gst_spinnaker_src_row_focus (row, row - pass->stride, src->nWidth);
+			stats->focus_pixels += src->nWidth - 1;
+		}
+		if (pass->pout)
+			gst_spinnaker_src_row_preview (src, acc, out_row, i, pass->pout, pass->pstride);
+		if (pass->gate)
+			gst_spinnaker_gate_row (&src->gate, out_row, i);
+	}
+}
+
+// Adds up the statistics of the bands into the frame's
+static void
+gst_spinnaker_src_merge_stats (GstSpinnakerSrc * src, guint n_bands)
+{
+	GstSpinnakerFrameStats *stats = &src->stats;
+	guint b, l, i;
+
+	*stats = src->band_stats[0];
+	for (b = 1; b < n_bands; b++) {
+		const GstSpinnakerFrameStats *band = &src->band_stats[b];
+		for (l = 0; l < 4; l++)
+			for (i = 0; i < 256; i++)
+				stats->lanes[l][i] += band->lanes[l][i];
+		stats->n_pixels += band->n_pixels;
+		stats->focus_sum += band->focus_sum;
+		stats->focus_pixels += band->focus_pixels;
+	}
+	gst_spinnaker_src_finish_stats (stats);
+}
+
+//Grabs next image from camera and puts it into a gstreamer buffer.
+//The buffer comes from pool if one is given; if the pool is exhausted the
+//image is dropped, though still averaged, and *buf is left NULL. *buf is also left NULL while an
+//HDR bracket or a block average is still being collected, and when gate-mode
+//drops the frame.
+static GstFlowReturn
+gst_spinnaker_src_capture (GstSpinnakerSrc * src, GstBufferPool * pool, GstBuffer ** buf)
+{
+	spinError err = SPINNAKER_ERR_SUCCESS;
+	GstFlowReturn ret;
+	GstMapInfo minfo;
+	guint64 hw_timestamp = 0;
+
+	*buf = NULL;
+
+	// another camera joined, left or renegotiated
+	if (g_atomic_int_compare_and_exchange (&src->link_dirty, 1, 0))
+		gst_spinnaker_src_apply_link_limit (src, src->hNodeMap);
+
+	//query camera and grab next image
+	spinImage hResultImage = NULL;
+	ret = gst_spinnaker_src_grab (src, &hResultImage);
+	if (ret != GST_FLOW_OK)
+		return ret;
+
+	bool8_t isIncomplete = False;
+	bool8_t hasFailed = False;
+
+	//check if image is complete 
+	//WARNING: This returns a boolean and is not handled if the image is incomplete
+	EXEANDCHECK(spinImageIsIncomplete(hResultImage, &isIncomplete));
+	spinImageGetTimeStamp(hResultImage, &hw_timestamp);
+
+	spinImage hConvertedImage = NULL;
+
+	// the correction reads unpacked mono pixels as they come and converts
+	// them to 8 bits itself, anything else is converted by the SDK first.
+	// Large deeper mono frames with nothing to correct are converted here
+	// too, with the SDK's shift split across the workers.
+	gboolean banded = gst_spinnaker_src_banded (src);
+	gboolean correct = gst_spinnaker_src_want_flat (src);
+	guint raw_bits = correct || (banded && !src->hdr_active) ? gst_spinnaker_src_raw_bits (hResultImage) : 0;
+
+	if (!correct && raw_bits == 8)
+		raw_bits = 0;
+	// either way the frame is written by us rather than the SDK
+	gboolean flat = correct || raw_bits;
+
+	if (src->hdr_active) {
+		// brackets keep the sensor's depth: unpacked mono frames are kept as
+		// they come, anything else is widened to Mono16 by the SDK
+		guint hdr_bits = gst_spinnaker_src_raw_bits (hResultImage);
+
+		err = spinImageCreateEmpty(&hConvertedImage);
+		if (err == SPINNAKER_ERR_SUCCESS)
+			err = hdr_bits ? spinImageDeepCopy(hResultImage, hConvertedImage) :
+					spinImageConvert(hResultImage, PixelFormat_Mono16, hConvertedImage);
+		if (err != SPINNAKER_ERR_SUCCESS) {
+			GST_WARNING_OBJECT (src, "unable to keep the frame, error %d", err);
+			hasFailed = True;
+		}
+		src->hdr_merge.in_bits = hdr_bits ? hdr_bits : 16;
+	} else if (raw_bits == 0) {
+    err = spinImageCreateEmpty(&hConvertedImage);
+    if (err != SPINNAKER_ERR_SUCCESS)
     {
-        printf("Unable to convert image. Non-fatal error %d...\n\n", err);
+        printf("Unable to create image. Non-fatal error %d...\n\n", err);
         hasFailed = True;
     }
 
+    err = spinImageConvert(hResultImage, PixelFormat_Mono8, hConvertedImage);
+    if (err != SPINNAKER_ERR_SUCCESS)
+    {
+        printf("Unable to convert image. Non-fatal error %d...\n\n", err);
+        hasFailed = True;
+    }
+	}
 
-	size_t imageSize;
-	EXEANDCHECK(spinImageGetBufferSize(hConvertedImage, &imageSize));
-	//printf("Converted Image size is %d\n",imageSize);
-
-	EXEANDCHECK(spinImageGetBufferSize(hResultImage, &imageSize));
-	//printf("Source Image size is %d\n",imageSize);
+	// HDR frames wait for the rest of their bracket; one that couldn't be
+	// converted breaks it like a lost one does
+	if (src->hdr_active && hasFailed) {
+		GST_WARNING_OBJECT (src, "conversion failed, dropping bracket");
+		if (hConvertedImage)
+			spinImageDestroy(hConvertedImage);
+		gst_spinnaker_src_hdr_clear (src);
+		EXEANDCHECK(spinImageRelease(hResultImage));
+		return GST_FLOW_OK;
+	}
+	if (src->hdr_active) {
+		gboolean complete = gst_spinnaker_src_hdr_store (src, hResultImage, hConvertedImage, hw_timestamp);
+		EXEANDCHECK(spinImageRelease(hResultImage));
+		if (!complete)
+			return GST_FLOW_OK;
+		hw_timestamp = src->hdr_timestamp;
+	}
 
-	//printf("nPitch size is %d\n",src->nPitch);
-	//printf("gst_stride size is %d\n",src->gst_stride);
+	// HDR frames are merged into a buffer of our own
+	if (src->hdr_active) {
+		if (!gst_spinnaker_src_alloc_frame (src, pool, buf)) {
+			gst_spinnaker_src_hdr_clear (src);
+			return GST_FLOW_OK;
+		}
+		gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
+		if (src->orient_sw) {
+			// merged as a whole frame, so oriented in a pass of its own
+			gst_spinnaker_src_hdr_merge (src, src->frame_scratch, src->nWidth * 2);
+			gst_spinnaker_orient_rows (&src->orient, src->frame_scratch, src->nWidth * 2,
+					src->nWidth, src->nHeight, 2, 0, src->nHeight, minfo.data, src->gst_stride);
+		} else {
+			gst_spinnaker_src_hdr_merge (src, minfo.data, src->gst_stride);
+		}
+		gst_buffer_unmap (*buf, &minfo);
+		gst_spinnaker_src_timestamp (src, *buf, hw_timestamp, TRUE);
+		return GST_FLOW_OK;
+	}
 
 	//grab pointer to image data	
 	void *data;
+	size_t image_stride = src->nPitch;
+	gboolean wrap = FALSE;
+
+	// averaged frames are only pushed once a block is complete
+	gboolean average = src->average_active;
+	gboolean emit = !average || src->average_mode != GST_SPINNAKER_AVERAGE_BLOCK ||
+			(src->average_count + 1) % src->average_frames == 0;
+	// a frame the pool has no buffer for is still averaged, only not pushed
+	gboolean push = emit;
+	gboolean aside = src->orient_sw || average;
+
+	// corrected frames are written into our buffer, which the statistics
+	// and the preview then read like any other frame
+	if (flat) {
+		spinImage hInput = raw_bits ? hResultImage : hConvertedImage;
+		void *in;
+		size_t in_stride;
+
+		if (emit) {
+			if (gst_spinnaker_src_alloc_frame (src, pool, buf)) {
+				gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
+			} else if (average) {
+				push = FALSE;
+			} else {
+				spinImageRelease(hResultImage);
+				if (hConvertedImage)
+					spinImageDestroy(hConvertedImage);
+				return GST_FLOW_OK;
+			}
+		}
+		EXEANDCHECK(spinImageGetData(hInput, &in));
+		if (spinImageGetStride(hInput, &in_stride) != SPINNAKER_ERR_SUCCESS)
+			in_stride = src->nWidth * (raw_bits > 8 ? 2 : 1);
+		// an oriented or averaged frame is corrected aside and goes out with the copy below
+		data = aside ? src->frame_scratch : minfo.data;
+		image_stride = aside ? src->nWidth : src->gst_stride;
+		if (correct)
+			gst_spinnaker_src_flat_correct (src, in, in_stride, raw_bits ? raw_bits : 8, data, image_stride);
+		else
+			gst_spinnaker_src_convert (src, in, in_stride, raw_bits, data, image_stride);
+		EXEANDCHECK(spinImageRelease(hResultImage));
+		if (hConvertedImage)
+			spinImageDestroy(hConvertedImage);
+		hConvertedImage = NULL;
+		goto frame_ready;
+	}
+
 	EXEANDCHECK(spinImageGetData(hConvertedImage, &data)); 
+	if (spinImageGetStride(hConvertedImage, &image_stride) != SPINNAKER_ERR_SUCCESS)
+		image_stride = src->nPitch;
+	EXEANDCHECK(spinImageRelease(hResultImage));
 
-	//copy image data into gstreamer buffer
-	for (int i = 0; i < src->nHeight; i++) {
-		//printf("Copy line %d \n",i);
-		memcpy (minfo.data + i * src->gst_stride, data + i * src->nPitch, src->nPitch);
+	// The converted image goes downstream as it is whenever its layout can
+	// be described: with a GstVideoMeta if downstream takes one, or as is if
+	// its stride happens to be the default one, and it is aligned as
+	// downstream asked. Ring and fd backed buffers come from a pool, so
+	// those are always copied into.
+	wrap = pool == NULL && !aside && (src->video_meta || image_stride == (size_t) src->gst_stride) &&
+			((guintptr) data & src->alloc_params.align) == 0;
+	if (wrap) {
+		gsize size = image_stride * src->nHeight;
+
+		*buf = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY, data, size, 0, size,
+				hConvertedImage, (GDestroyNotify) spinImageDestroy);
+		if (src->video_meta) {
+			gsize offsets[GST_VIDEO_MAX_PLANES] = { 0, };
+			gint strides[GST_VIDEO_MAX_PLANES] = { (gint) image_stride, };
+
+			gst_buffer_add_video_meta_full (*buf, GST_VIDEO_FRAME_FLAG_NONE,
+					GST_VIDEO_INFO_FORMAT (&src->vinfo), src->nWidth, src->nHeight, 1, offsets, strides);
+		}
+	} else if (emit) {
+		if (gst_spinnaker_src_alloc_frame (src, pool, buf)) {
+			gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
+		} else if (average) {
+			push = FALSE;
+		} else {
+			spinImageDestroy(hConvertedImage);
+			return GST_FLOW_OK;
+		}
 	}
 
-	//release image and buffer
-	EXEANDCHECK(spinImageRelease(hResultImage));
-	//EXEANDCHECK(spinImageRelease(hConvertedImage));
-	spinImageDestroy(hConvertedImage);
+frame_ready:
+	// the preview is box filtered from the same rows
+	GstBuffer *preview = NULL;
+	GstSpinnakerAuxPad *preview_pad = push ? gst_spinnaker_src_want_preview (src) : NULL;
+	GstMapInfo pinfo;
+	if (preview_pad) {
+		preview = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&src->preview_info));
+		gst_buffer_map (preview, &pinfo, GST_MAP_WRITE);
+	}
 
-	gst_buffer_unmap (*buf, &minfo);
+	//copy image data into gstreamer buffer, gathering statistics while the rows are in cache.
+	//Rows are only repacked one by one when the strides differ.
+	gboolean copy_rows = push && !wrap && (!flat || aside);
+	gboolean want_stats = src->auto_exposure || src->statistics;
+	gboolean want_focus = src->statistics && src->focus_metric;
+	gboolean gate = push && src->gate.sad != NULL;
+	if (copy_rows && image_stride == (size_t) src->gst_stride && !want_stats && !preview && !gate && !aside && !banded) {
+		memcpy (minfo.data, data, image_stride * src->nHeight);
+		copy_rows = FALSE;
+	}
+	if (copy_rows || want_stats || preview || average || gate) {
+		// averaged rows are pushed from the average, the statistics are of the frame captured
+		GstSpinnakerRowPass pass = {
+			src, data, image_stride,
+			average ? src->average_out : (const guint8 *) data, average ? src->nWidth : image_stride,
+			copy_rows ? minfo.data : NULL, NULL, 0,
+			want_stats, want_focus, average, emit, gate, ORIENT_BAND
+		};
+		guint n_bands = banded ? gst_spinnaker_workers_get_n_threads (src->workers) : 1;
+
+		if (preview) {
+			pass.pout = src->orient_sw ? src->preview_scratch : pinfo.data;
+			pass.pstride = src->orient_sw ? src->preview_width : GST_VIDEO_INFO_PLANE_STRIDE (&src->preview_info, 0);
+		}
+		while ((preview && pass.unit % src->preview_scale) || (gate && pass.unit % GST_SPINNAKER_GATE_BLOCK))
+			pass.unit += ORIENT_BAND;
+		gst_spinnaker_workers_run (src->workers, n_bands, gst_spinnaker_src_row_job, &pass);
+		if (want_stats)
+			gst_spinnaker_src_merge_stats (src, n_bands);
+	}
+	if (average)
+		src->average_count++;
+
+	// a wrapped image is destroyed with its buffer
+	if (!wrap) {
+		if (hConvertedImage)
+			spinImageDestroy(hConvertedImage);
+		if (*buf)
+			gst_buffer_unmap (*buf, &minfo);
+	}
 
-    src->duration = 1000000000.0/src->framerate; 
-	// If we do not use gst_base_src_set_do_timestamp() we need to add timestamps manually
-	src->last_frame_time += src->duration;   // Get the timestamp for this frame
-	if(!gst_base_src_get_do_timestamp(GST_BASE_SRC(psrc))){
-		GST_BUFFER_PTS(*buf) = src->last_frame_time;  // convert ms to ns
-		GST_BUFFER_DTS(*buf) = src->last_frame_time;  // convert ms to ns
+	if (src->statistics && *buf)
+		gst_spinnaker_src_attach_stats (src, *buf);
+
+	// feed the statistics back to the camera, and pick up property changes
+	if (src->auto_exposure)
+		gst_spinnaker_src_auto_exposure (src);
+	gst_spinnaker_src_apply_exposure (src);
+
+	// the rest of the block is still to come
+	if (*buf == NULL)
+		return GST_FLOW_OK;
+
+	// decided before stamping, so that a dropped frame doesn't count. The
+	// preview and the statistics still follow the scene.
+	gboolean drop = FALSE;
+	if (gate && !gst_spinnaker_src_gate_pass (src)) {
+		GST_OBJECT_LOCK (src);
+		src->frames_suppressed++;
+		GST_OBJECT_UNLOCK (src);
+		if (src->gate_mode == GST_SPINNAKER_GATE_DROP)
+			drop = TRUE;
+		else
+			GST_BUFFER_FLAG_SET (*buf, GST_BUFFER_FLAG_GAP);
 	}
-	GST_BUFFER_DURATION(*buf) = src->duration;
-	GST_DEBUG_OBJECT(src, "pts, dts: %" GST_TIME_FORMAT ", duration: %d ms", GST_TIME_ARGS (src->last_frame_time), GST_TIME_AS_MSECONDS(src->duration));
 
-	// count frames, and send EOS when required frame number is reached
-	GST_BUFFER_OFFSET(*buf) = src->n_frames;  // from videotestsrc
-	src->n_frames++;
-	GST_BUFFER_OFFSET_END(*buf) = src->n_frames;  // from videotestsrc
-	if (psrc->parent.num_buffers>0)  // If we were asked for a specific number of buffers, stop when complete
-		if (G_UNLIKELY(src->n_frames >= psrc->parent.num_buffers))
-			return GST_FLOW_EOS;
+	gst_spinnaker_src_timestamp (src, *buf, hw_timestamp, !drop);
+
+	if (preview) {
+		if (src->orient_sw)
+			gst_spinnaker_orient_rows (&src->orient, src->preview_scratch, src->preview_width,
+					src->preview_width, src->preview_height, 1, 0, src->preview_height,
+					pinfo.data, GST_VIDEO_INFO_PLANE_STRIDE (&src->preview_info, 0));
+		gst_buffer_unmap (preview, &pinfo);
+		GST_BUFFER_PTS (preview) = GST_BUFFER_PTS (*buf);
+		GST_BUFFER_DTS (preview) = GST_BUFFER_DTS (*buf);
+		GST_BUFFER_DURATION (preview) = GST_BUFFER_DURATION (*buf) * src->preview_interval;
+		gst_spinnaker_src_push_aux (src, preview_pad, preview);
+		gst_spinnaker_src_aux_unref (preview_pad);
+	}
+
+	if (drop) {
+		gst_buffer_unref (*buf);
+		*buf = NULL;
+	}
 
 	return GST_FLOW_OK;
 	fail:
 	return GST_FLOW_ERROR;
 }
+
+// While armed, frames go into the ring instead of downstream. Returns the
+// frame to push as preview, or NULL.
+static GstBuffer *
+gst_spinnaker_src_ring_store (GstSpinnakerSrc * src, GstBuffer * buf)
+{
+	guint slot;
+	gboolean preview;
+
+	if (src->ring_count == src->ring_size) {
+		gst_buffer_unref (src->ring[src->ring_head]);
+		src->ring_head = (src->ring_head + 1) % src->ring_size;
+		src->ring_count--;
+	}
+
+	preview = src->pretrigger_preview > 0 && src->armed_frames % src->pretrigger_preview == 0;
+	src->armed_frames++;
+
+	slot = (src->ring_head + src->ring_count) % src->ring_size;
+	src->ring[slot] = buf;
+	src->ring_pushed[slot] = preview;
+	src->ring_count++;
+
+	return preview ? gst_buffer_ref (buf) : NULL;
+}
+
+// Hands the ring, oldest first, to the base class in one buffer list.
+// Frames already pushed as preview are left out.
+static gboolean
+gst_spinnaker_src_ring_flush (GstSpinnakerSrc * src)
+{
+	GstBufferList *list;
+	gboolean first = TRUE;
+	guint i;
+
+	list = gst_buffer_list_new_sized (src->ring_count);
+	for (i = 0; i < src->ring_count; i++) {
+		guint slot = (src->ring_head + i) % src->ring_size;
+		GstBuffer *frame = src->ring[slot];
+
+		src->ring[slot] = NULL;
+		if (src->ring_pushed[slot]) {
+			gst_buffer_unref (frame);
+			continue;
+		}
+		// the ring goes back in time from the preview stream
+		if (first) {
+			frame = gst_buffer_make_writable (frame);
+			GST_BUFFER_FLAG_SET (frame, GST_BUFFER_FLAG_DISCONT);
+			first = FALSE;
+		}
+		gst_buffer_list_add (list, frame);
+	}
+	GST_INFO_OBJECT (src, "trigger: flushing %u pre-trigger frames", gst_buffer_list_length (list));
+	src->ring_head = 0;
+	src->ring_count = 0;
+
+	if (gst_buffer_list_length (list) == 0) {
+		gst_buffer_list_unref (list);
+		return FALSE;
+	}
+	gst_base_src_submit_buffer_list (GST_BASE_SRC (src), list);
+	return TRUE;
+}
+
+#ifdef OVERRIDE_CREATE
+static GstFlowReturn
+gst_spinnaker_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+{
+	GstSpinnakerSrc *src = GST_SPINNAKER_SRC (psrc);
+	GstFlowReturn ret;
+
+	*buf = NULL;
+	gst_spinnaker_src_setup_streaming_thread (src);
+
+	while (*buf == NULL) {
+		GstBuffer *frame;
+
+		// checked for every frame: while armed without previews, nothing
+		// else gets create() to return
+		if (g_atomic_int_compare_and_exchange (&src->arm_pending, 1, 0)) {
+			if (src->ring_pool) {
+				src->armed = TRUE;
+				src->armed_frames = 0;
+			} else {
+				GST_WARNING_OBJECT (src, "arm requested but no pre-trigger ring was configured");
+			}
+		}
+
+		if (src->armed && g_atomic_int_compare_and_exchange (&src->trigger_pending, 1, 0)) {
+			src->armed = FALSE;
+			if (gst_spinnaker_src_ring_flush (src))
+				return GST_FLOW_OK;
+		}
+
+		ret = gst_spinnaker_src_capture (src, src->armed ? src->ring_pool : src->fd_pool, &frame);
+		if (ret != GST_FLOW_OK) {
+			gst_spinnaker_src_release_streaming_thread (src);
+			return ret;
+		}
+		if (frame == NULL)
+			continue;
+
+		if (src->armed)
+			*buf = gst_spinnaker_src_ring_store (src, frame);
+		else
+			*buf = frame;
+	}
+
+	gst_spinnaker_src_push_rois (src, *buf);
+
+	if (src->latency_dirty)
+		gst_spinnaker_src_update_latency (src);
+
+	// send EOS when required frame number is reached
+	if (psrc->parent.num_buffers>0)  // If we were asked for a specific number of buffers, stop when complete
+		if (G_UNLIKELY(src->n_frames >= psrc->parent.num_buffers)) {
+			gst_spinnaker_src_release_streaming_thread (src);
+			return GST_FLOW_EOS;
+		}
+
+	return GST_FLOW_OK;
+}
 #endif // OVERRIDE_CREATE
 
 static gboolean
@@ -931,7 +4673,13 @@ plugin_init (GstPlugin * plugin)
   /* FIXME Remember to set the rank if it's an element that is meant
      to be autoplugged by decodebin. */
   return gst_element_register (plugin, "spinnakersrc", GST_RANK_NONE,
-      GST_TYPE_SPINNAKER_SRC);
+      GST_TYPE_SPINNAKER_SRC) &&
+      gst_element_register (plugin, "spinnakerrawsink", GST_RANK_NONE,
+      GST_TYPE_SPINNAKER_RAW_SINK) &&
+      gst_element_register (plugin, "spinnakerrawsrc", GST_RANK_NONE,
+      GST_TYPE_SPINNAKER_RAW_SRC) &&
+      gst_device_provider_register (plugin, "spinnakerdeviceprovider", GST_RANK_PRIMARY,
+      GST_TYPE_SPINNAKER_DEVICE_PROVIDER);
 
 }
 /* FIXME: these are normally defined by the GStreamer build system.
@@ -21,9 +21,19 @@
 #define _GST_SPINNAKER_SRC_H_
 
 #include <gst/base/gstpushsrc.h>
+#include <gst/video/video.h>
 
 #include <SpinnakerC.h>
 
+#include "gstspinnakerhdr.h"
+#include "gstspinnakerworkers.h"
+#include "gstspinnakerfdpool.h"
+#include "gstspinnakerflat.h"
+#include "gstspinnakerorient.h"
+#include "gstspinnakeraverage.h"
+#include "gstspinnakergate.h"
+#include "gstspinnakerdevice.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_SPINNAKER_SRC   (gst_spinnaker_src_get_type())
@@ -50,6 +60,54 @@ typedef enum
 	GST_LUT_GAMMA
 } LUTType;
 
+// Statistics gathered while a frame is copied out of the SDK image
+typedef struct
+{
+	guint32 lanes[4][256];  // interleaved partial histograms, merged at the end of the frame
+	guint32 histogram[256];
+	guint64 n_pixels;
+	guint64 sum;
+	guint64 saturated;
+	guint8 min;
+	guint8 max;
+	guint64 focus_sum;      // sum of dx^2 + dy^2
+	guint64 focus_pixels;
+} GstSpinnakerFrameStats;
+
+// An extra src pad fed from create(), next to the base class' own pad.
+// The streaming thread holds a reference while it pushes, so the pad can be
+// released meanwhile.
+typedef struct
+{
+  gint ref_count;             // atomic
+  GstPad *pad;
+  const gchar *stream_name;   // suffix of the stream id
+  GstCaps *caps;              // caps still to be announced, NULL once sent
+  gboolean set_up;            // sized for the negotiated frame, streaming thread only
+  gboolean started;           // stream-start and segment sent
+
+  // ROI pads
+  guint roi;                  // index into the rois property
+  GstVideoInfo info;          // layout of a tightly packed ROI frame
+  gboolean video_meta;        // downstream accepts strided buffers
+} GstSpinnakerAuxPad;
+
+// A region of the frame, in pixels
+typedef struct
+{
+  guint x;
+  guint y;
+  guint width;
+  guint height;
+} GstSpinnakerRoi;
+
+typedef enum
+{
+  GST_SPINNAKER_CALIBRATION_NONE,
+  GST_SPINNAKER_CALIBRATION_DARK,
+  GST_SPINNAKER_CALIBRATION_FLAT
+} GstSpinnakerCalibration;
+
 struct _GstSpinnakerSrc
 {
   GstPushSrc base_spinnaker_src;
@@ -57,12 +115,16 @@ struct _GstSpinnakerSrc
   spinSystem hSystem;
   //spinImage convertedImage;
   spinCameraList hCameraList;
+  spinCamera hCamera;          // the open camera, NULL when stopped
+  spinNodeMapHandle hNodeMap;  // GenICam nodemap of the open camera, NULL when stopped
 
   // device
   gboolean cameraPresent;
   int lMemId;  // ID of the allocated memory
   unsigned int nWidth;
   unsigned int cameraID;
+  gchar *serial;              // opens the camera by serial number instead of cameraID
+  gchar *device_user_id;      // or by the name set in the camera
   unsigned int nHeight;
   unsigned int nBitsPerPixel;
   unsigned int nBytesPerPixel;
@@ -80,7 +142,8 @@ struct _GstSpinnakerSrc
   gfloat exposure;     // ms
   gfloat framerate;
   gfloat maxframerate;
-  gint gain;           // dB
+  gdouble fps_min, fps_max;   // capture rates the camera can reach, 0 if unknown
+  gfloat gain;         // dB
 //  gfloat cam_min_gain, cam_max_gain;  //  min and max settable values for the camera
   gint blacklevel;
   unsigned int rgain;
@@ -90,6 +153,7 @@ struct _GstSpinnakerSrc
   gint sharpness;
   gint vflip;
   gint hflip;
+  GstSpinnakerRotation rotation;
   WhiteBalanceType whitebalance;
   gboolean WB_in_progress;   // will be >0 when WB in progress, value will be number of frames until we abort WB
   gint WB_progress;   // will be >0 when WB in progress, value will be number of frames until we abort WB
@@ -102,11 +166,158 @@ struct _GstSpinnakerSrc
   gdouble lut_outputoffset[2];
   gfloat gamma;
 
+  // link bandwidth
+  gint throughput_limit;      // bytes/s, 0 leaves the camera default
+  gboolean throughput_auto;   // share throughput_budget with the other cameras in this process
+  gint64 throughput_budget;   // bytes/s available on the shared host controller
+  unsigned int nRawBytesPerPixel;  // bytes per pixel on the wire (before conversion)
+  gdouble link_demand;        // bytes/s at the negotiated size and rate, 0 until then; link_registry lock
+  gint link_dirty;            // another camera joined, left or renegotiated, atomic
+
+  // host-side auto exposure
+  gboolean auto_exposure;
+  gboolean auto_gain;
+  gint ae_target;             // mean grey level to aim for
+  gint ae_interval;           // frames between camera updates
+  gdouble ae_damping;         // fraction of the correction applied per update
+  gfloat ae_max_gain;         // dB
+  gint ae_frame_count;
+  GstSpinnakerFrameStats stats;
+  gboolean statistics;        // attach GstSpinnakerStatsMeta to every buffer
+  gboolean focus_metric;
+
+  // pre-trigger recording
+  guint pretrigger_frames;    // frames to keep before a trigger
+  guint pretrigger_time;      // ms to keep before a trigger, whichever is longer
+  guint pretrigger_preview;   // push every Nth frame while armed, 0 pushes nothing
+  gboolean armed;
+  gint trigger_pending;       // atomic, set by the trigger signal or upstream event
+  gint arm_pending;           // atomic
+  GstBufferPool *ring_pool;   // fixed pool backing the ring, preallocated at set_caps
+  GstBuffer **ring;
+  gboolean *ring_pushed;      // ring entries already sent as preview
+  guint ring_size;
+  guint ring_head;            // oldest entry
+  guint ring_count;
+  guint64 armed_frames;
+
+  // HDR bracketing with the camera's sequencer
+  guint hdr_frames;           // exposures per HDR frame, fewer than 2 disables bracketing
+  gdouble hdr_ratio;          // exposure ratio between consecutive sequencer sets
+  gboolean hdr_active;        // the sequencer is running the bracket
+  gboolean hdr_chunk;         // frames carry ChunkSequencerSetActive
+  gdouble hdr_exposure[GST_SPINNAKER_HDR_MAX_FRAMES];  // us, as applied to each set
+  spinImage hdr_images[GST_SPINNAKER_HDR_MAX_FRAMES];  // copied frames of the current bracket
+  guint hdr_next;             // set expected next
+  guint64 hdr_timestamp;      // camera timestamp of the bracket's first frame
+  GstSpinnakerHdrMerge hdr_merge;
+
+  // per-frame work split in bands of rows across threads
+  guint conversion_threads;   // 0 for one per core
+  GstSpinnakerWorkers *workers;
+  GstSpinnakerFrameStats *band_stats;  // one per thread
+
+  // where the streaming thread and the workers run
+  gchar *cpu_affinity;
+  GArray *cpus;               // gint, parsed from cpu_affinity
+  GstSpinnakerScheduling scheduling;
+  gint scheduling_priority;
+  GstSpinnakerThreadConfig thread_config;
+  GThread *streaming_thread;  // the thread set up, NULL if none yet
+  GstSpinnakerThreadState *streaming_state;  // how it ran before
+
+  // downscaled preview on the "preview" request pad
+  GstSpinnakerAuxPad *preview;  // object lock
+  guint preview_scale;        // box filter size
+  gdouble preview_rate;       // fps, 0 previews every frame
+  GstVideoInfo preview_info;
+  guint preview_interval;     // captured frames per preview frame
+  guint preview_count;
+  guint32 *preview_acc;       // column sums of the current box row, one per thread
+  guint preview_width;        // size before orientation
+  guint preview_height;
+  guint8 *preview_scratch;    // unoriented preview, when oriented in software
+
+  // regions pushed as views of the full frame on the "roi_%u" request pads
+  gchar *rois_string;
+  GArray *rois;               // GstSpinnakerRoi
+  GList *roi_pads;            // GstSpinnakerAuxPad, object lock
+  GstVideoInfo vinfo;         // negotiated output frame
+  gboolean video_meta;        // downstream takes the SDK's stride through GstVideoMeta
+  GstSpinnakerMemory memory;  // what frames are pushed in
+  GstBufferPool *fd_pool;     // negotiated memfd / DMABuf pool, NULL for system memory
+  GstAllocator *allocator;    // for frames not taken from a pool, as downstream asked
+  GstAllocationParams alloc_params;
+
+  // latency, estimated from the capture chain and answered to LATENCY queries
+  GstClockTime latency_min;   // GST_CLOCK_TIME_NONE until negotiated
+  GstClockTime latency_max;
+  gdouble readout_us;         // sensor readout of one frame
+  gint64 link_bps;            // bytes/s the link delivers, 0 if unknown
+  gint64 stream_buffers;      // frames the SDK may hold before create() takes them
+  gboolean latency_dirty;     // a property affecting latency changed
+
+  // orientation the camera can't do with ReverseX / ReverseY, done in the copy pass
+  GstSpinnakerOrientation orient;
+  gboolean orient_sw;
+  guint8 *frame_scratch;      // corrected frame, when it is oriented or averaged on the way out
+
+  // temporal averaging, accumulators are nWidth * nHeight
+  guint average_frames;       // 0 or 1 for none
+  GstSpinnakerAverageMode average_mode;
+  gboolean average_active;
+  guint16 *average_sum;       // block sums
+  guint32 *average_acc;       // Q16 running average
+  guint average_shift;        // the running average moves 1 / 2^shift per frame
+  guint64 average_count;      // frames averaged since negotiation
+  guint8 *average_out;        // the averaged frame, copied out row by row
+
+  // frames without changes since the last one pushed are dropped or flagged
+  GstSpinnakerGateMode gate_mode;
+  gdouble gate_threshold;     // grey levels a block has to change by on average
+  guint gate_keepalive;       // ms, most time between frames pushed, 0 for none
+  GstSpinnakerGate gate;      // sampled rows and block sums, set up with the caps
+  gint64 gate_last_push;      // monotonic us of the last frame let through
+  guint64 frames_suppressed;  // object lock
+
+  // waiting for the camera to come back when it drops off the bus
+  GstSpinnakerReconnect reconnect;
+  guint reconnect_timeout;    // ms, 0 to wait for good
+  gchar *camera_serial;       // of the open camera, NULL if it is not watched
+  spinArrivalEvent hArrival;
+  spinRemovalEvent hRemoval;
+  gint camera_lost;           // set by the removal event, atomic
+  GMutex reconnect_lock;
+  GCond reconnect_cond;       // signalled by the arrival event
+  gboolean camera_arrived;    // reconnect_lock
+  gboolean discont;           // the next frame follows an outage
+  guint reconnects;           // object lock, with the outages
+  GstClockTime outage_total;
+  GstClockTime outage_last;
+
+  // flat-field and dark-frame correction, maps are nWidth * nHeight
+  gchar *dark_location;
+  gchar *flat_location;
+  guint16 *dark_map;          // 16 bit full scale, NULL for none
+  guint16 *flat_map;          // averaged flat frame the gain map is made from
+  guint16 *flat_gain;         // GST_SPINNAKER_FLAT_GAIN_ONE based
+  guint flat_width, flat_height;
+  GstSpinnakerFlatField flat;
+
+  // calibration, averaging frames into a new dark or flat map
+  GstSpinnakerCalibration calib_request;  // set by the action signals, object lock
+  guint calib_request_frames;
+  GstSpinnakerCalibration calib;          // in progress on the streaming thread
+  guint calib_frames;
+  guint calib_count;
+  guint32 *calib_acc;
+
   gboolean exposure_just_changed;
   gboolean gain_just_changed;
   gboolean binning_just_changed;
 
   // stream
+  gboolean unlocking;
   gboolean acq_started;
   gint n_frames;
   gint total_timeouts;
@@ -117,6 +328,12 @@ struct _GstSpinnakerSrc
 struct _GstSpinnakerSrcClass
 {
   GstPushSrcClass base_spinnaker_src_class;
+
+  /* actions */
+  void (*trigger) (GstSpinnakerSrc * src);
+  void (*arm) (GstSpinnakerSrc * src);
+  void (*capture_dark) (GstSpinnakerSrc * src, guint n_frames);
+  void (*capture_flat) (GstSpinnakerSrc * src, guint n_frames);
 };
 
 GType gst_spinnaker_src_get_type (void);
@@ -0,0 +1,148 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gstspinnakeraverage.h"
+
+GType
+gst_spinnaker_average_mode_get_type (void)
+{
+	static GType type;
+	static const GEnumValue values[] = {
+		{GST_SPINNAKER_AVERAGE_BLOCK, "One frame per N, their mean", "block"},
+		{GST_SPINNAKER_AVERAGE_RECURSIVE, "Every frame, running exponential average", "recursive"},
+		{0, NULL, NULL}
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstSpinnakerAverageMode", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+void
+gst_spinnaker_average_block_row (guint16 * acc, const guint8 * row, guint width, guint n_frames, guint8 * out)
+{
+	// (sum + n / 2) / n as a multiply by the rounded up reciprocal, which
+	// can come out one too high; that is checked for and corrected
+	guint recip = MIN ((65536 + n_frames - 1) / n_frames, 65535);
+	guint x = 0;
+
+#ifdef __SSE2__
+	{
+		const __m128i zero = _mm_setzero_si128 ();
+		const __m128i half = _mm_set1_epi16 ((gint16) (n_frames / 2));
+		const __m128i r = _mm_set1_epi16 ((gint16) recip);
+		const __m128i n = _mm_set1_epi16 ((gint16) n_frames);
+
+		for (; x + 16 <= width; x += 16) {
+			__m128i p = _mm_loadu_si128 ((const __m128i *) (row + x));
+			__m128i lo = _mm_add_epi16 (_mm_loadu_si128 ((const __m128i *) (acc + x)), _mm_unpacklo_epi8 (p, zero));
+			__m128i hi = _mm_add_epi16 (_mm_loadu_si128 ((const __m128i *) (acc + x + 8)), _mm_unpackhi_epi8 (p, zero));
+
+			if (out) {
+				__m128i s_lo = _mm_adds_epu16 (lo, half), s_hi = _mm_adds_epu16 (hi, half);
+				__m128i q_lo = _mm_mulhi_epu16 (s_lo, r), q_hi = _mm_mulhi_epu16 (s_hi, r);
+				// adding the all ones mask of "q * n > sum" takes one off
+				q_lo = _mm_add_epi16 (q_lo, _mm_xor_si128 (_mm_cmpeq_epi16 (_mm_subs_epu16 (
+						_mm_mullo_epi16 (q_lo, n), s_lo), zero), _mm_cmpeq_epi16 (zero, zero)));
+				q_hi = _mm_add_epi16 (q_hi, _mm_xor_si128 (_mm_cmpeq_epi16 (_mm_subs_epu16 (
+						_mm_mullo_epi16 (q_hi, n), s_hi), zero), _mm_cmpeq_epi16 (zero, zero)));
+				_mm_storeu_si128 ((__m128i *) (out + x), _mm_packus_epi16 (q_lo, q_hi));
+				lo = hi = zero;
+			}
+			_mm_storeu_si128 ((__m128i *) (acc + x), lo);
+			_mm_storeu_si128 ((__m128i *) (acc + x + 8), hi);
+		}
+	}
+#endif
+
+	for (; x < width; x++) {
+		guint sum = acc[x] + row[x];
+
+		if (out) {
+			guint s = MIN (sum + n_frames / 2, 65535);
+			guint q = s * recip >> 16;
+			out[x] = q * n_frames > s ? q - 1 : q;
+			sum = 0;
+		}
+		acc[x] = sum;
+	}
+}
+
+void
+gst_spinnaker_average_recursive_row (guint32 * acc, const guint8 * row, guint width, guint shift,
+		gboolean first, guint8 * out)
+{
+	gint32 round = shift ? 1 << (shift - 1) : 0;
+	guint x = 0;
+
+	if (first) {
+		for (x = 0; x < width; x++) {
+			acc[x] = (guint32) row[x] << 16;
+			out[x] = row[x];
+		}
+		return;
+	}
+
+#ifdef __SSE2__
+	{
+		const __m128i zero = _mm_setzero_si128 ();
+		const __m128i r = _mm_set1_epi32 (round);
+		const __m128i half = _mm_set1_epi32 (32768);
+		const __m128i count = _mm_cvtsi32_si128 (shift);
+
+		// sixteen pixels a time, in four vectors of 32 bit lanes
+		for (; x + 16 <= width; x += 16) {
+			__m128i p = _mm_loadu_si128 ((const __m128i *) (row + x));
+			__m128i p16[2] = { _mm_unpacklo_epi8 (p, zero), _mm_unpackhi_epi8 (p, zero) };
+			__m128i o[4];
+			guint k;
+
+			for (k = 0; k < 4; k++) {
+				__m128i v = k & 1 ? _mm_unpackhi_epi16 (p16[k / 2], zero) : _mm_unpacklo_epi16 (p16[k / 2], zero);
+				__m128i a = _mm_loadu_si128 ((const __m128i *) (acc + x + 4 * k));
+				__m128i d = _mm_sub_epi32 (_mm_slli_epi32 (v, 16), a);
+
+				a = _mm_add_epi32 (a, _mm_sra_epi32 (_mm_add_epi32 (d, r), count));
+				_mm_storeu_si128 ((__m128i *) (acc + x + 4 * k), a);
+				o[k] = _mm_srli_epi32 (_mm_add_epi32 (a, half), 16);
+			}
+			_mm_storeu_si128 ((__m128i *) (out + x), _mm_packus_epi16 (
+					_mm_packs_epi32 (o[0], o[1]), _mm_packs_epi32 (o[2], o[3])));
+		}
+	}
+#endif
+
+	for (; x < width; x++) {
+		gint32 d = (gint32) (((guint32) row[x] << 16) - acc[x]);
+
+		// arithmetic shift, like the vector code
+		acc[x] += (guint32) ((d + round) >> shift);
+		out[x] = (guint8) MIN ((acc[x] + 32768) >> 16, 255);
+	}
+}
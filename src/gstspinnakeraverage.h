@@ -0,0 +1,51 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_AVERAGE_H_
+#define _GST_SPINNAKER_AVERAGE_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GST_SPINNAKER_AVERAGE_BLOCK,       // one frame out per N in, their mean
+  GST_SPINNAKER_AVERAGE_RECURSIVE    // every frame out, exponential average
+} GstSpinnakerAverageMode;
+
+#define GST_TYPE_SPINNAKER_AVERAGE_MODE (gst_spinnaker_average_mode_get_type ())
+GType gst_spinnaker_average_mode_get_type (void);
+
+// frames a 16 bit block accumulator holds without overflowing
+#define GST_SPINNAKER_AVERAGE_MAX_FRAMES 256
+
+// Adds a GRAY8 row to a block sum. If out is given, the row completes the
+// block: out gets the rounded mean of n_frames rows and the sum restarts.
+void gst_spinnaker_average_block_row (guint16 * acc, const guint8 * row,
+    guint width, guint n_frames, guint8 * out);
+
+// Moves a Q16 running average 1 / 2^shift of the way towards a GRAY8 row
+// and writes the rounded result to out. The first row sets it.
+void gst_spinnaker_average_recursive_row (guint32 * acc, const guint8 * row,
+    guint width, guint shift, gboolean first, guint8 * out);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,446 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:provider-spinnakerdeviceprovider
+ *
+ * Lists the Spinnaker cameras as #GstDevice, each making a spinnakersrc
+ * that opens its camera by serial number. What a camera supports is only
+ * known once it has been opened, so that is probed once per camera and
+ * process and then remembered by serial number. A camera already open,
+ * such as one streaming, isn't touched; it is listed with the caps of any
+ * camera until it can be probed. A started provider adds
+ * and removes cameras as the SDK reports them arriving and leaving,
+ * without enumerating them again.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include "gstspinnakerdevice.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_spinnaker_device_provider_debug);
+#define GST_CAT_DEFAULT gst_spinnaker_device_provider_debug
+
+// caps of any camera, narrowed down by probing
+#define DEVICE_CAPS "video/x-raw, format = (string) { GRAY8, GRAY16_LE }"
+
+GType
+gst_spinnaker_reconnect_get_type (void)
+{
+	static GType type;
+	static const GEnumValue values[] = {
+		{GST_SPINNAKER_RECONNECT_OFF, "Fail", "off"},
+		{GST_SPINNAKER_RECONNECT_HOLD, "Wait for the camera", "hold"},
+		{GST_SPINNAKER_RECONNECT_GAP, "Wait for the camera, pushing gaps", "gap"},
+		{0, NULL, NULL}
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstSpinnakerReconnect", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+// What is known about a camera
+typedef struct
+{
+	gchar *serial;
+	gchar *vendor;
+	gchar *model;
+	gchar *user_id;
+	GstCaps *caps;              // the caps of any camera until probed
+	gboolean probed;
+} GstSpinnakerDeviceInfo;
+
+// Cameras seen by this process, by serial number. Entries are kept when
+// a camera leaves, it is likely to come back.
+static GMutex cache_lock;
+static GHashTable *cache;
+
+G_DEFINE_TYPE (GstSpinnakerDevice, gst_spinnaker_device, GST_TYPE_DEVICE);
+G_DEFINE_TYPE_WITH_CODE (GstSpinnakerDeviceProvider, gst_spinnaker_device_provider,
+    GST_TYPE_DEVICE_PROVIDER,
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "spinnakerdeviceprovider", 0,
+        "debug category for the spinnaker device provider"));
+
+static void
+gst_spinnaker_device_info_free (GstSpinnakerDeviceInfo * info)
+{
+	g_free (info->serial);
+	g_free (info->vendor);
+	g_free (info->model);
+	g_free (info->user_id);
+	gst_caps_unref (info->caps);
+	g_free (info);
+}
+
+static gboolean
+gst_spinnaker_device_node_readable (spinNodeHandle hNode)
+{
+	bool8_t available = False, readable = False;
+
+	return spinNodeIsAvailable(hNode, &available) == SPINNAKER_ERR_SUCCESS && available &&
+			spinNodeIsReadable(hNode, &readable) == SPINNAKER_ERR_SUCCESS && readable;
+}
+
+gchar *
+gst_spinnaker_device_get_tl_string (spinCamera hCamera, const gchar * name)
+{
+	spinNodeMapHandle hNodeMap = NULL;
+	spinNodeHandle hNode = NULL;
+	char value[MAX_BUFF_LEN];
+	size_t len = MAX_BUFF_LEN;
+
+	if (spinCameraGetTLDeviceNodeMap(hCamera, &hNodeMap) != SPINNAKER_ERR_SUCCESS ||
+			spinNodeMapGetNode(hNodeMap, name, &hNode) != SPINNAKER_ERR_SUCCESS ||
+			!gst_spinnaker_device_node_readable (hNode) ||
+			spinStringGetValue(hNode, value, &len) != SPINNAKER_ERR_SUCCESS)
+		return NULL;
+	return g_strndup (value, len);
+}
+
+// Opens the camera to read the frame size and largest rate it delivers.
+// Returns NULL for a camera already opened, by spinnakersrc in this
+// process or elsewhere: closing it again would pull it from under its
+// user.
+static GstCaps *
+gst_spinnaker_device_probe_caps (spinCamera hCamera)
+{
+	GstCaps *caps;
+	spinNodeMapHandle hNodeMap = NULL;
+	spinNodeHandle hNode = NULL;
+	int64_t width = 0, height = 0;
+	double fps = 0.0;
+	bool8_t initialized = False;
+
+	if (spinCameraIsInitialized(hCamera, &initialized) != SPINNAKER_ERR_SUCCESS || initialized) {
+		GST_DEBUG ("camera is in use, not probing it");
+		return NULL;
+	}
+	if (spinCameraInit(hCamera) != SPINNAKER_ERR_SUCCESS) {
+		GST_DEBUG ("camera can't be opened, not probing it");
+		return NULL;
+	}
+	if (spinCameraGetNodeMap(hCamera, &hNodeMap) == SPINNAKER_ERR_SUCCESS) {
+		if (spinNodeMapGetNode(hNodeMap, "WidthMax", &hNode) == SPINNAKER_ERR_SUCCESS &&
+				gst_spinnaker_device_node_readable (hNode))
+			spinIntegerGetValue(hNode, &width);
+		if (spinNodeMapGetNode(hNodeMap, "HeightMax", &hNode) == SPINNAKER_ERR_SUCCESS &&
+				gst_spinnaker_device_node_readable (hNode))
+			spinIntegerGetValue(hNode, &height);
+		if (spinNodeMapGetNode(hNodeMap, "AcquisitionFrameRate", &hNode) == SPINNAKER_ERR_SUCCESS &&
+				gst_spinnaker_device_node_readable (hNode))
+			spinFloatGetMax(hNode, &fps);
+	}
+	spinCameraDeInit(hCamera);
+
+	// spinnakersrc always streams the full sensor
+	caps = gst_caps_from_string (DEVICE_CAPS);
+	if (width > 0 && height > 0)
+		gst_caps_set_simple (caps, "width", G_TYPE_INT, (gint) width, "height", G_TYPE_INT, (gint) height, NULL);
+	if (fps > 0.0) {
+		gint fps_n, fps_d;
+
+		gst_util_double_to_fraction (fps, &fps_n, &fps_d);
+		gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION_RANGE, 0, 1, fps_n, fps_d, NULL);
+	}
+	return caps;
+}
+
+// Makes a device for the camera, probing the camera only until it could be
+// probed once
+static GstDevice *
+gst_spinnaker_device_new (spinCamera hCamera)
+{
+	GstSpinnakerDeviceInfo *info;
+	GstSpinnakerDevice *device;
+	GstStructure *props;
+	gchar *serial, *name;
+
+	serial = gst_spinnaker_device_get_tl_string (hCamera, "DeviceSerialNumber");
+	if (serial == NULL)
+		return NULL;
+
+	g_mutex_lock (&cache_lock);
+	if (cache == NULL)
+		cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+				(GDestroyNotify) gst_spinnaker_device_info_free);
+	info = g_hash_table_lookup (cache, serial);
+	if (info == NULL) {
+		info = g_new0 (GstSpinnakerDeviceInfo, 1);
+		info->serial = g_strdup (serial);
+		info->vendor = gst_spinnaker_device_get_tl_string (hCamera, "DeviceVendorName");
+		info->model = gst_spinnaker_device_get_tl_string (hCamera, "DeviceModelName");
+		info->caps = gst_caps_from_string (DEVICE_CAPS);
+		g_hash_table_insert (cache, info->serial, info);
+	}
+	if (!info->probed) {
+		GstCaps *caps = gst_spinnaker_device_probe_caps (hCamera);
+
+		if (caps) {
+			gst_caps_replace (&info->caps, caps);
+			gst_caps_unref (caps);
+			info->probed = TRUE;
+			GST_INFO ("probed camera %s: %" GST_PTR_FORMAT, serial, info->caps);
+		}
+	}
+	// the user set name can change at any time, and costs nothing to read
+	g_free (info->user_id);
+	info->user_id = gst_spinnaker_device_get_tl_string (hCamera, "DeviceUserID");
+
+	props = gst_structure_new ("spinnaker-proplist",
+			"device.serial", G_TYPE_STRING, info->serial,
+			"device.vendor", G_TYPE_STRING, info->vendor,
+			"device.model", G_TYPE_STRING, info->model,
+			"device.user-id", G_TYPE_STRING, info->user_id, NULL);
+	if (info->user_id && info->user_id[0])
+		name = g_strdup_printf ("%s (%s)", info->user_id, info->serial);
+	else
+		name = g_strdup_printf ("%s (%s)", info->model ? info->model : "Spinnaker camera", info->serial);
+	device = g_object_new (GST_TYPE_SPINNAKER_DEVICE, "display-name", name,
+			"caps", info->caps, "device-class", "Video/Source", "properties", props, NULL);
+	device->serial = serial;
+	g_mutex_unlock (&cache_lock);
+
+	g_free (name);
+	gst_structure_free (props);
+	return GST_DEVICE (device);
+}
+
+static GstElement *
+gst_spinnaker_device_create_element (GstDevice * device, const gchar * name)
+{
+	GstElement *element = gst_element_factory_make ("spinnakersrc", name);
+
+	if (element)
+		g_object_set (element, "serial", GST_SPINNAKER_DEVICE (device)->serial, NULL);
+	return element;
+}
+
+static gboolean
+gst_spinnaker_device_reconfigure_element (GstDevice * device, GstElement * element)
+{
+	GstElementFactory *factory = gst_element_get_factory (element);
+
+	if (factory == NULL || g_strcmp0 (GST_OBJECT_NAME (factory), "spinnakersrc") != 0)
+		return FALSE;
+	g_object_set (element, "serial", GST_SPINNAKER_DEVICE (device)->serial, NULL);
+	return TRUE;
+}
+
+static void
+gst_spinnaker_device_finalize (GObject * object)
+{
+	g_free (GST_SPINNAKER_DEVICE (object)->serial);
+
+	G_OBJECT_CLASS (gst_spinnaker_device_parent_class)->finalize (object);
+}
+
+static void
+gst_spinnaker_device_class_init (GstSpinnakerDeviceClass * klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	GstDeviceClass *device_class = GST_DEVICE_CLASS (klass);
+
+	gobject_class->finalize = gst_spinnaker_device_finalize;
+	device_class->create_element = gst_spinnaker_device_create_element;
+	device_class->reconfigure_element = gst_spinnaker_device_reconfigure_element;
+}
+
+static void
+gst_spinnaker_device_init (GstSpinnakerDevice * device)
+{
+}
+
+// The device listed for serial while monitoring, NULL if there is none.
+// Looks at the devices already added rather than asking for them, which
+// would probe the cameras again before the provider counts as started.
+static GstDevice *
+gst_spinnaker_device_provider_find (GstDeviceProvider * provider, const gchar * serial)
+{
+	GstDevice *found = NULL;
+	GList *l;
+
+	GST_OBJECT_LOCK (provider);
+	for (l = provider->devices; l && found == NULL; l = l->next)
+		if (g_strcmp0 (GST_SPINNAKER_DEVICE (l->data)->serial, serial) == 0)
+			found = gst_object_ref (l->data);
+	GST_OBJECT_UNLOCK (provider);
+	return found;
+}
+
+static GList *
+gst_spinnaker_device_provider_probe (GstDeviceProvider * provider)
+{
+	spinSystem hSystem = NULL;
+	spinCameraList hCameraList = NULL;
+	size_t numCameras = 0, i;
+	GList *devices = NULL;
+
+	if (spinSystemGetInstance(&hSystem) != SPINNAKER_ERR_SUCCESS)
+		return NULL;
+	if (spinCameraListCreateEmpty(&hCameraList) == SPINNAKER_ERR_SUCCESS) {
+		if (spinSystemGetCameras(hSystem, hCameraList) == SPINNAKER_ERR_SUCCESS &&
+				spinCameraListGetSize(hCameraList, &numCameras) == SPINNAKER_ERR_SUCCESS) {
+			for (i = 0; i < numCameras; i++) {
+				spinCamera hCamera = NULL;
+				GstDevice *device;
+
+				if (spinCameraListGet(hCameraList, i, &hCamera) != SPINNAKER_ERR_SUCCESS)
+					continue;
+				device = gst_spinnaker_device_new (hCamera);
+				if (device)
+					devices = g_list_append (devices, device);
+				spinCameraRelease(hCamera);
+			}
+		}
+		spinCameraListClear(hCameraList);
+		spinCameraListDestroy(hCameraList);
+	}
+	spinSystemReleaseInstance(hSystem);
+
+	return devices;
+}
+
+// Called from the SDK's event thread
+static void
+gst_spinnaker_device_provider_arrival (uint64_t deviceSerialNumber, void *pUserData)
+{
+	GstDeviceProvider *provider = pUserData;
+	GstSpinnakerDeviceProvider *self = GST_SPINNAKER_DEVICE_PROVIDER (provider);
+	gchar *serial = g_strdup_printf ("%" G_GUINT64_FORMAT, (guint64) deviceSerialNumber);
+	spinCameraList hCameraList = NULL;
+	spinCamera hCamera = NULL;
+	GstDevice *device = NULL;
+
+	GST_DEBUG_OBJECT (provider, "camera %s arrived", serial);
+	if ((device = gst_spinnaker_device_provider_find (provider, serial))) {
+		gst_object_unref (device);
+		g_free (serial);
+		return;
+	}
+
+	if (spinCameraListCreateEmpty(&hCameraList) == SPINNAKER_ERR_SUCCESS) {
+		if (spinSystemGetCameras(self->hSystem, hCameraList) == SPINNAKER_ERR_SUCCESS &&
+				spinCameraListGetBySerial(hCameraList, serial, &hCamera) == SPINNAKER_ERR_SUCCESS &&
+				hCamera) {
+			device = gst_spinnaker_device_new (hCamera);
+			spinCameraRelease(hCamera);
+		}
+		spinCameraListClear(hCameraList);
+		spinCameraListDestroy(hCameraList);
+	}
+	if (device)
+		gst_device_provider_device_add (provider, device);
+	g_free (serial);
+}
+
+static void
+gst_spinnaker_device_provider_removal (uint64_t deviceSerialNumber, void *pUserData)
+{
+	GstDeviceProvider *provider = pUserData;
+	gchar *serial = g_strdup_printf ("%" G_GUINT64_FORMAT, (guint64) deviceSerialNumber);
+	GstDevice *device = gst_spinnaker_device_provider_find (provider, serial);
+
+	GST_DEBUG_OBJECT (provider, "camera %s removed", serial);
+	if (device) {
+		gst_device_provider_device_remove (provider, device);
+		gst_object_unref (device);
+	}
+	g_free (serial);
+}
+
+static gboolean
+gst_spinnaker_device_provider_start (GstDeviceProvider * provider)
+{
+	GstSpinnakerDeviceProvider *self = GST_SPINNAKER_DEVICE_PROVIDER (provider);
+	GList *devices, *l;
+
+	if (spinSystemGetInstance(&self->hSystem) != SPINNAKER_ERR_SUCCESS) {
+		self->hSystem = NULL;
+		return FALSE;
+	}
+
+	// listen first, so no camera arrives unnoticed while the others are listed
+	if (spinArrivalEventCreate(&self->hArrival, gst_spinnaker_device_provider_arrival, provider) != SPINNAKER_ERR_SUCCESS ||
+			spinSystemRegisterArrivalEvent(self->hSystem, self->hArrival) != SPINNAKER_ERR_SUCCESS)
+		GST_WARNING_OBJECT (provider, "no arrival events, new cameras won't be listed");
+	if (spinRemovalEventCreate(&self->hRemoval, gst_spinnaker_device_provider_removal, provider) != SPINNAKER_ERR_SUCCESS ||
+			spinSystemRegisterRemovalEvent(self->hSystem, self->hRemoval) != SPINNAKER_ERR_SUCCESS)
+		GST_WARNING_OBJECT (provider, "no removal events, unplugged cameras will stay listed");
+
+	devices = gst_spinnaker_device_provider_probe (provider);
+	for (l = devices; l; l = l->next) {
+		GstDevice *known = gst_spinnaker_device_provider_find (provider, GST_SPINNAKER_DEVICE (l->data)->serial);
+
+		if (known) {
+			gst_object_unref (known);
+			gst_object_unref (gst_object_ref_sink (l->data));
+		} else {
+			gst_device_provider_device_add (provider, l->data);
+		}
+	}
+	g_list_free (devices);
+
+	return TRUE;
+}
+
+static void
+gst_spinnaker_device_provider_stop (GstDeviceProvider * provider)
+{
+	GstSpinnakerDeviceProvider *self = GST_SPINNAKER_DEVICE_PROVIDER (provider);
+
+	if (self->hArrival) {
+		spinSystemUnregisterArrivalEvent(self->hSystem, self->hArrival);
+		spinArrivalEventDestroy(self->hArrival);
+		self->hArrival = NULL;
+	}
+	if (self->hRemoval) {
+		spinSystemUnregisterRemovalEvent(self->hSystem, self->hRemoval);
+		spinRemovalEventDestroy(self->hRemoval);
+		self->hRemoval = NULL;
+	}
+	if (self->hSystem) {
+		spinSystemReleaseInstance(self->hSystem);
+		self->hSystem = NULL;
+	}
+}
+
+static void
+gst_spinnaker_device_provider_class_init (GstSpinnakerDeviceProviderClass * klass)
+{
+	GstDeviceProviderClass *provider_class = GST_DEVICE_PROVIDER_CLASS (klass);
+
+	provider_class->probe = gst_spinnaker_device_provider_probe;
+	provider_class->start = gst_spinnaker_device_provider_start;
+	provider_class->stop = gst_spinnaker_device_provider_stop;
+
+	gst_device_provider_class_set_static_metadata (provider_class,
+			"Spinnaker Camera Provider", "Source/Video",
+			"Lists Spinnaker cameras by serial number", "David Thompson <dave@republicofdave.net>");
+}
+
+static void
+gst_spinnaker_device_provider_init (GstSpinnakerDeviceProvider * self)
+{
+}
@@ -0,0 +1,87 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_DEVICE_H_
+#define _GST_SPINNAKER_DEVICE_H_
+
+#include <gst/gst.h>
+
+#include <SpinnakerC.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SPINNAKER_DEVICE_PROVIDER   (gst_spinnaker_device_provider_get_type())
+#define GST_SPINNAKER_DEVICE_PROVIDER(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SPINNAKER_DEVICE_PROVIDER,GstSpinnakerDeviceProvider))
+
+#define GST_TYPE_SPINNAKER_DEVICE   (gst_spinnaker_device_get_type())
+#define GST_SPINNAKER_DEVICE(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SPINNAKER_DEVICE,GstSpinnakerDevice))
+
+// What spinnakersrc does while its camera is gone
+typedef enum
+{
+  GST_SPINNAKER_RECONNECT_OFF,    // stop the pipeline with an error
+  GST_SPINNAKER_RECONNECT_HOLD,   // wait for it, pushing nothing
+  GST_SPINNAKER_RECONNECT_GAP     // wait for it, pushing GAP events over the frames missed
+} GstSpinnakerReconnect;
+
+#define GST_TYPE_SPINNAKER_RECONNECT (gst_spinnaker_reconnect_get_type ())
+GType gst_spinnaker_reconnect_get_type (void);
+
+typedef struct _GstSpinnakerDeviceProvider GstSpinnakerDeviceProvider;
+typedef struct _GstSpinnakerDeviceProviderClass GstSpinnakerDeviceProviderClass;
+typedef struct _GstSpinnakerDevice GstSpinnakerDevice;
+typedef struct _GstSpinnakerDeviceClass GstSpinnakerDeviceClass;
+
+struct _GstSpinnakerDeviceProvider
+{
+  GstDeviceProvider parent;
+
+  // while monitoring
+  spinSystem hSystem;
+  spinArrivalEvent hArrival;
+  spinRemovalEvent hRemoval;
+};
+
+struct _GstSpinnakerDeviceProviderClass
+{
+  GstDeviceProviderClass parent_class;
+};
+
+struct _GstSpinnakerDevice
+{
+  GstDevice parent;
+
+  gchar *serial;
+};
+
+struct _GstSpinnakerDeviceClass
+{
+  GstDeviceClass parent_class;
+};
+
+GType gst_spinnaker_device_provider_get_type (void);
+GType gst_spinnaker_device_get_type (void);
+
+// A string node of the camera's transport layer nodemap, which is readable
+// without opening the camera. NULL if the camera has no such node.
+gchar *gst_spinnaker_device_get_tl_string (spinCamera hCamera, const gchar * name);
+
+G_END_DECLS
+
+#endif
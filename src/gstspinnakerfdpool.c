@@ -0,0 +1,215 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+// memfd_create
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_LINUX_DMA_HEAP_H
+#include <linux/dma-heap.h>
+#endif
+
+#include <gst/allocators/allocators.h>
+
+#include "gstspinnakerfdpool.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_spinnaker_fd_pool_debug);
+#define GST_CAT_DEFAULT gst_spinnaker_fd_pool_debug
+
+#define DMA_HEAP_PATH "/dev/dma_heap/system"
+
+GType
+gst_spinnaker_memory_get_type (void)
+{
+	static GType type;
+	static const GEnumValue values[] = {
+		{GST_SPINNAKER_MEMORY_SYSTEM, "System memory", "system"},
+		{GST_SPINNAKER_MEMORY_MEMFD, "memfd, shareable with other processes", "memfd"},
+		{GST_SPINNAKER_MEMORY_DMABUF, "DMABuf heap, memfd if there is none", "dmabuf"},
+		{0, NULL, NULL}
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstSpinnakerMemory", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+G_DEFINE_TYPE_WITH_CODE (GstSpinnakerFdPool, gst_spinnaker_fd_pool, GST_TYPE_BUFFER_POOL,
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "spinnakerfdpool", 0,
+        "debug category for the spinnaker fd buffer pool"));
+
+static gboolean
+gst_spinnaker_fd_pool_set_config (GstBufferPool * pool, GstStructure * config)
+{
+	GstSpinnakerFdPool *self = GST_SPINNAKER_FD_POOL (pool);
+	GstCaps *caps;
+	guint size, min, max;
+
+	if (!gst_buffer_pool_config_get_params (config, &caps, &size, &min, &max) || size == 0)
+		return FALSE;
+	self->size = size;
+
+	return GST_BUFFER_POOL_CLASS (gst_spinnaker_fd_pool_parent_class)->set_config (pool, config);
+}
+
+// Creates a sealed memfd of the given size. The seals promise the other
+// side of a unix socket that the file can't shrink under its mapping.
+static gint
+gst_spinnaker_fd_pool_memfd (gsize size)
+{
+#ifdef HAVE_MEMFD_CREATE
+	gint fd = memfd_create ("spinnakersrc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+	if (fd < 0)
+		return -1;
+	if (ftruncate (fd, size) < 0) {
+		close (fd);
+		return -1;
+	}
+	fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+	return fd;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static GstFlowReturn
+gst_spinnaker_fd_pool_alloc_buffer (GstBufferPool * pool, GstBuffer ** buffer,
+		GstBufferPoolAcquireParams * params)
+{
+	GstSpinnakerFdPool *self = GST_SPINNAKER_FD_POOL (pool);
+	GstMemory *mem;
+	gint fd;
+
+#ifdef HAVE_LINUX_DMA_HEAP_H
+	if (self->memory == GST_SPINNAKER_MEMORY_DMABUF) {
+		struct dma_heap_allocation_data data = { 0, };
+
+		data.len = self->size;
+		data.fd_flags = O_RDWR | O_CLOEXEC;
+		if (ioctl (self->heap_fd, DMA_HEAP_IOCTL_ALLOC, &data) < 0) {
+			GST_ERROR_OBJECT (self, "unable to allocate %u bytes from " DMA_HEAP_PATH ": %s",
+					self->size, g_strerror (errno));
+			return GST_FLOW_ERROR;
+		}
+		// the allocator syncs the CPU caches on every map and unmap
+		mem = gst_dmabuf_allocator_alloc (self->allocator, data.fd, self->size);
+		goto done;
+	}
+#endif
+
+	fd = gst_spinnaker_fd_pool_memfd (self->size);
+	if (fd < 0) {
+		GST_ERROR_OBJECT (self, "unable to create a memfd of %u bytes: %s",
+				self->size, g_strerror (errno));
+		return GST_FLOW_ERROR;
+	}
+	// memfd pages are plain memory, keep them mapped for the pool's lifetime
+	mem = gst_fd_allocator_alloc (self->allocator, fd, self->size, GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+
+#ifdef HAVE_LINUX_DMA_HEAP_H
+done:
+#endif
+	if (mem == NULL)
+		return GST_FLOW_ERROR;
+	*buffer = gst_buffer_new ();
+	gst_buffer_append_memory (*buffer, mem);
+	return GST_FLOW_OK;
+}
+
+static void
+gst_spinnaker_fd_pool_finalize (GObject * object)
+{
+	GstSpinnakerFdPool *self = GST_SPINNAKER_FD_POOL (object);
+
+	if (self->heap_fd >= 0)
+		close (self->heap_fd);
+	if (self->allocator)
+		gst_object_unref (self->allocator);
+
+	G_OBJECT_CLASS (gst_spinnaker_fd_pool_parent_class)->finalize (object);
+}
+
+static void
+gst_spinnaker_fd_pool_class_init (GstSpinnakerFdPoolClass * klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	GstBufferPoolClass *pool_class = GST_BUFFER_POOL_CLASS (klass);
+
+	gobject_class->finalize = gst_spinnaker_fd_pool_finalize;
+	pool_class->set_config = gst_spinnaker_fd_pool_set_config;
+	pool_class->alloc_buffer = gst_spinnaker_fd_pool_alloc_buffer;
+}
+
+static void
+gst_spinnaker_fd_pool_init (GstSpinnakerFdPool * self)
+{
+	self->heap_fd = -1;
+}
+
+GstBufferPool *
+gst_spinnaker_fd_pool_new (GstSpinnakerMemory memory)
+{
+	GstSpinnakerFdPool *self;
+
+	self = g_object_new (GST_TYPE_SPINNAKER_FD_POOL, NULL);
+	gst_object_ref_sink (self);
+
+#ifdef HAVE_LINUX_DMA_HEAP_H
+	if (memory == GST_SPINNAKER_MEMORY_DMABUF) {
+		self->heap_fd = open (DMA_HEAP_PATH, O_RDWR | O_CLOEXEC);
+		if (self->heap_fd >= 0) {
+			self->memory = GST_SPINNAKER_MEMORY_DMABUF;
+			self->allocator = gst_dmabuf_allocator_new ();
+			GST_INFO_OBJECT (self, "allocating from " DMA_HEAP_PATH);
+			return GST_BUFFER_POOL (self);
+		}
+		GST_WARNING_OBJECT (self, "unable to open " DMA_HEAP_PATH ": %s, using memfd", g_strerror (errno));
+	}
+#else
+	if (memory == GST_SPINNAKER_MEMORY_DMABUF)
+		GST_WARNING_OBJECT (self, "built without DMABuf heap support, using memfd");
+#endif
+
+#ifdef HAVE_MEMFD_CREATE
+	self->memory = GST_SPINNAKER_MEMORY_MEMFD;
+	self->allocator = gst_fd_allocator_new ();
+	GST_INFO_OBJECT (self, "allocating from memfd");
+	return GST_BUFFER_POOL (self);
+#else
+	GST_ERROR_OBJECT (self, "built without memfd support");
+	gst_object_unref (self);
+	return NULL;
+#endif
+}
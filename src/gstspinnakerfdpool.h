@@ -0,0 +1,70 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_FD_POOL_H_
+#define _GST_SPINNAKER_FD_POOL_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// Where spinnakersrc puts the frames it pushes
+typedef enum
+{
+  GST_SPINNAKER_MEMORY_SYSTEM,   // plain memory, or the SDK's own image
+  GST_SPINNAKER_MEMORY_MEMFD,    // anonymous memfd, can be passed to other processes
+  GST_SPINNAKER_MEMORY_DMABUF    // DMABuf heap, memfd when there is none
+} GstSpinnakerMemory;
+
+#define GST_TYPE_SPINNAKER_MEMORY (gst_spinnaker_memory_get_type ())
+GType gst_spinnaker_memory_get_type (void);
+
+#define GST_TYPE_SPINNAKER_FD_POOL   (gst_spinnaker_fd_pool_get_type())
+#define GST_SPINNAKER_FD_POOL(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SPINNAKER_FD_POOL,GstSpinnakerFdPool))
+#define GST_IS_SPINNAKER_FD_POOL(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SPINNAKER_FD_POOL))
+
+typedef struct _GstSpinnakerFdPool GstSpinnakerFdPool;
+typedef struct _GstSpinnakerFdPoolClass GstSpinnakerFdPoolClass;
+
+// A buffer pool whose buffers each own one file descriptor, so a frame can
+// go to another process (unixfdsink, shmsink) or be imported by a
+// downstream element without copying the pixels again
+struct _GstSpinnakerFdPool
+{
+  GstBufferPool parent;
+
+  GstSpinnakerMemory memory;   // what is actually allocated
+  GstAllocator *allocator;
+  gint heap_fd;                // DMABuf heap, -1 for memfd
+  guint size;
+};
+
+struct _GstSpinnakerFdPoolClass
+{
+  GstBufferPoolClass parent_class;
+};
+
+GType gst_spinnaker_fd_pool_get_type (void);
+
+// Returns NULL if neither a DMABuf heap nor memfd can be used
+GstBufferPool *gst_spinnaker_fd_pool_new (GstSpinnakerMemory memory);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,241 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gstspinnakerflat.h"
+
+static inline guint8
+gst_spinnaker_flat_pixel (const GstSpinnakerFlatField * ff, guint v, guint shift, gsize i)
+{
+	guint d = v << shift;
+	guint g = ff->gain ? ff->gain[i] : GST_SPINNAKER_FLAT_GAIN_ONE;
+	guint hi;
+
+	// same steps and rounding as the vector code
+	d = ff->dark ? (d > ff->dark[i] ? d - ff->dark[i] : 0) : d;
+	d = d > ff->offset ? d - ff->offset : 0;
+	hi = MIN ((d * g >> 16) + 32, 65535);
+	return (guint8) MIN (hi >> 6, 255);
+}
+
+void
+gst_spinnaker_flat_correct_rows (const GstSpinnakerFlatField * ff, guint first_row, guint n_rows)
+{
+	guint shift = 16 - ff->in_bits;
+	guint y, x;
+
+	for (y = first_row; y < first_row + n_rows && y < ff->height; y++) {
+		const guint8 *in8 = ff->in + y * ff->in_stride;
+		const guint16 *in16 = (const guint16 *) in8;
+		const guint16 *dark = ff->dark ? ff->dark + (gsize) y * ff->width : NULL;
+		const guint16 *gain = ff->gain ? ff->gain + (gsize) y * ff->width : NULL;
+		guint8 *out = ff->out + y * ff->out_stride;
+		gsize row = (gsize) y * ff->width;
+
+		if (ff->acc) {
+			guint32 *acc = ff->acc + row;
+			for (x = 0; x < ff->width; x++)
+				acc[x] += (ff->in_bits == 8 ? in8[x] : in16[x]) << shift;
+		}
+		x = 0;
+
+#ifdef __SSE2__
+		{
+			const __m128i zero = _mm_setzero_si128 ();
+			const __m128i count = _mm_cvtsi32_si128 (shift);
+			const __m128i offset = _mm_set1_epi16 ((gint16) ff->offset);
+			const __m128i one = _mm_set1_epi16 ((gint16) GST_SPINNAKER_FLAT_GAIN_ONE);
+			const __m128i round = _mm_set1_epi16 (32);
+
+			// eight pixels at a time in unsigned 16 bit lanes, saturating so
+			// nothing wraps below the dark level or above full scale
+			for (; x + 8 <= ff->width; x += 8) {
+				__m128i v, g;
+
+				if (ff->in_bits == 8)
+					v = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (in8 + x)), zero);
+				else
+					v = _mm_loadu_si128 ((const __m128i *) (in16 + x));
+				v = _mm_sll_epi16 (v, count);
+				if (dark)
+					v = _mm_subs_epu16 (v, _mm_loadu_si128 ((const __m128i *) (dark + x)));
+				v = _mm_subs_epu16 (v, offset);
+				g = gain ? _mm_loadu_si128 ((const __m128i *) (gain + x)) : one;
+				v = _mm_srli_epi16 (_mm_adds_epu16 (_mm_mulhi_epu16 (v, g), round), 6);
+				_mm_storel_epi64 ((__m128i *) (out + x), _mm_packus_epi16 (v, v));
+			}
+		}
+#endif
+
+		for (; x < ff->width; x++)
+			out[x] = gst_spinnaker_flat_pixel (ff, ff->in_bits == 8 ? in8[x] : in16[x], shift, row + x);
+	}
+}
+
+void
+gst_spinnaker_flat_shift_rows (const GstSpinnakerFlatField * ff, guint first_row, guint n_rows)
+{
+	guint shift = ff->in_bits - 8;
+	guint y, x;
+
+	for (y = first_row; y < first_row + n_rows && y < ff->height; y++) {
+		const guint16 *in = (const guint16 *) (ff->in + y * ff->in_stride);
+		guint8 *out = ff->out + y * ff->out_stride;
+
+		x = 0;
+#ifdef __SSE2__
+		{
+			const __m128i count = _mm_cvtsi32_si128 (shift);
+
+			for (; x + 16 <= ff->width; x += 16) {
+				__m128i lo = _mm_srl_epi16 (_mm_loadu_si128 ((const __m128i *) (in + x)), count);
+				__m128i hi = _mm_srl_epi16 (_mm_loadu_si128 ((const __m128i *) (in + x + 8)), count);
+				_mm_storeu_si128 ((__m128i *) (out + x), _mm_packus_epi16 (lo, hi));
+			}
+		}
+#endif
+
+		for (; x < ff->width; x++)
+			out[x] = (guint8) MIN (in[x] >> shift, 255);
+	}
+}
+
+// Light a pixel received in the flat frame
+static inline guint
+gst_spinnaker_flat_signal (const guint16 * flat, const guint16 * dark, gsize i)
+{
+	if (dark == NULL)
+		return flat[i];
+	return flat[i] > dark[i] ? flat[i] - dark[i] : 0;
+}
+
+void
+gst_spinnaker_flat_compute_gain (guint16 * gain, const guint16 * flat, const guint16 * dark, gsize n_pixels)
+{
+	gdouble mean = 0.0;
+	gsize i;
+
+	for (i = 0; i < n_pixels; i++)
+		mean += gst_spinnaker_flat_signal (flat, dark, i);
+	mean /= MAX (n_pixels, 1);
+
+	for (i = 0; i < n_pixels; i++) {
+		guint f = gst_spinnaker_flat_signal (flat, dark, i);
+		// dead pixels stay as they are rather than being blown up
+		gain[i] = f == 0 ? GST_SPINNAKER_FLAT_GAIN_ONE :
+				(guint16) MIN (mean * GST_SPINNAKER_FLAT_GAIN_ONE / f + 0.5, 65535.0);
+	}
+}
+
+// Reads the next header number of a PGM file, skipping comments
+static gboolean
+gst_spinnaker_flat_pgm_number (const gchar ** p, const gchar * end, guint * value)
+{
+	gchar *stop;
+
+	while (*p < end && (g_ascii_isspace (**p) || **p == '#')) {
+		if (**p == '#')
+			while (*p < end && **p != '\n')
+				(*p)++;
+		else
+			(*p)++;
+	}
+	if (*p == end || !g_ascii_isdigit (**p))
+		return FALSE;
+	*value = (guint) strtoul (*p, &stop, 10);
+	*p = stop;
+	return TRUE;
+}
+
+guint16 *
+gst_spinnaker_flat_load_pgm (const gchar * location, guint * width, guint * height, GError ** error)
+{
+	gchar *contents;
+	gsize length, n, i;
+	const gchar *p, *end;
+	guint maxval, bytes;
+	guint16 *map = NULL;
+
+	if (!g_file_get_contents (location, &contents, &length, error))
+		return NULL;
+	p = contents;
+	end = contents + length;
+
+	if (length < 2 || p[0] != 'P' || p[1] != '5') {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a binary PGM file", location);
+		goto done;
+	}
+	p += 2;
+	if (!gst_spinnaker_flat_pgm_number (&p, end, width) ||
+			!gst_spinnaker_flat_pgm_number (&p, end, height) ||
+			!gst_spinnaker_flat_pgm_number (&p, end, &maxval) ||
+			maxval == 0 || maxval > 65535 || p == end) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s has a broken PGM header", location);
+		goto done;
+	}
+	p++;   // the single whitespace before the pixels
+
+	bytes = maxval < 256 ? 1 : 2;
+	n = (gsize) *width * *height;
+	if ((gsize) (end - p) < n * bytes) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is truncated", location);
+		goto done;
+	}
+
+	map = g_new (guint16, n);
+	for (i = 0; i < n; i++) {
+		const guint8 *s = (const guint8 *) p + i * bytes;
+		guint v = bytes == 1 ? s[0] : (s[0] << 8) | s[1];   // PGM is big endian
+		map[i] = (guint16) ((v * 65535 + maxval / 2) / maxval);
+	}
+
+done:
+	g_free (contents);
+	return map;
+}
+
+gboolean
+gst_spinnaker_flat_save_pgm (const gchar * location, const guint16 * map, guint width, guint height, GError ** error)
+{
+	gchar *header = g_strdup_printf ("P5\n%u %u\n65535\n", width, height);
+	gsize header_len = strlen (header), n = (gsize) width * height, i;
+	guint8 *contents = g_malloc (header_len + n * 2);
+	gboolean ret;
+
+	memcpy (contents, header, header_len);
+	for (i = 0; i < n; i++) {
+		contents[header_len + 2 * i] = map[i] >> 8;
+		contents[header_len + 2 * i + 1] = map[i] & 0xff;
+	}
+	ret = g_file_set_contents (location, (const gchar *) contents, header_len + n * 2, error);
+
+	g_free (header);
+	g_free (contents);
+	return ret;
+}
@@ -0,0 +1,72 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_FLAT_H_
+#define _GST_SPINNAKER_FLAT_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// gain maps are fixed point, this is 1.0
+#define GST_SPINNAKER_FLAT_GAIN_ONE 16384
+
+// One frame to correct. Maps are width * height pixels without padding,
+// the dark map in 16 bit full scale units.
+typedef struct
+{
+  const guint8 *in;         // GRAY8, or 16 bit containers holding in_bits bits
+  guint in_stride;
+  guint in_bits;            // 8 .. 16
+  const guint16 *dark;      // NULL for none
+  const guint16 *gain;      // GST_SPINNAKER_FLAT_GAIN_ONE based, NULL for none
+  guint16 offset;           // subtracted after the dark map, 16 bit full scale
+  guint32 *acc;             // sums the input for calibration, NULL when not calibrating
+  guint8 *out;              // GRAY8
+  guint out_stride;
+  guint width;
+  guint height;
+} GstSpinnakerFlatField;
+
+// Computes out = (in - dark - offset) * gain for rows [first_row,
+// first_row + n_rows), scaling to 8 bits in the same pass
+void gst_spinnaker_flat_correct_rows (const GstSpinnakerFlatField * ff,
+    guint first_row, guint n_rows);
+
+// Converts rows [first_row, first_row + n_rows) of 16 bit containers to
+// 8 bits the way the SDK does, keeping the top 8 of in_bits bits. No
+// correction is applied; only in, in_stride, in_bits, out, out_stride and
+// width are read.
+void gst_spinnaker_flat_shift_rows (const GstSpinnakerFlatField * ff,
+    guint first_row, guint n_rows);
+
+// Gain that evens out flat - dark, a uniformly lit frame, to its mean
+void gst_spinnaker_flat_compute_gain (guint16 * gain, const guint16 * flat,
+    const guint16 * dark, gsize n_pixels);
+
+// Maps are read and written as binary PGM. 8 bit files and any maxval are
+// scaled to 16 bit full scale on load; maps are saved with maxval 65535.
+guint16 *gst_spinnaker_flat_load_pgm (const gchar * location, guint * width,
+    guint * height, GError ** error);
+gboolean gst_spinnaker_flat_save_pgm (const gchar * location, const guint16 * map,
+    guint width, guint height, GError ** error);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,140 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gstspinnakergate.h"
+
+GType
+gst_spinnaker_gate_mode_get_type (void)
+{
+	static GType type;
+	static const GEnumValue values[] = {
+		{GST_SPINNAKER_GATE_OFF, "Push every frame", "off"},
+		{GST_SPINNAKER_GATE_DROP, "Drop unchanged frames", "drop"},
+		{GST_SPINNAKER_GATE_GAP, "Flag unchanged frames as gaps", "gap"},
+		{0, NULL, NULL}
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstSpinnakerGateMode", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+void
+gst_spinnaker_gate_init (GstSpinnakerGate * gate, guint width, guint height)
+{
+	gsize size = (gsize) width * ((height + GST_SPINNAKER_GATE_ROW_STEP - 1) / GST_SPINNAKER_GATE_ROW_STEP);
+
+	gate->width = width;
+	gate->height = height;
+	gate->blocks_x = (width + GST_SPINNAKER_GATE_BLOCK - 1) / GST_SPINNAKER_GATE_BLOCK;
+	gate->blocks_y = (height + GST_SPINNAKER_GATE_BLOCK - 1) / GST_SPINNAKER_GATE_BLOCK;
+	gate->sad = g_new0 (guint32, (gsize) gate->blocks_x * gate->blocks_y);
+	gate->ref = g_malloc (size);
+	gate->next = g_malloc (size);
+	gate->has_ref = FALSE;
+}
+
+void
+gst_spinnaker_gate_clear (GstSpinnakerGate * gate)
+{
+	g_free (gate->sad);
+	g_free (gate->ref);
+	g_free (gate->next);
+	memset (gate, 0, sizeof (*gate));
+}
+
+void
+gst_spinnaker_gate_row (GstSpinnakerGate * gate, const guint8 * row, guint y)
+{
+	gsize offset = (gsize) (y / GST_SPINNAKER_GATE_ROW_STEP) * gate->width;
+	const guint8 *ref = gate->ref + offset;
+	guint32 *sad = gate->sad + (gsize) (y / GST_SPINNAKER_GATE_BLOCK) * gate->blocks_x;
+	guint bx;
+
+	if (y % GST_SPINNAKER_GATE_ROW_STEP)
+		return;
+	memcpy (gate->next + offset, row, gate->width);
+	if (!gate->has_ref)
+		return;
+
+	for (bx = 0; bx < gate->blocks_x; bx++) {
+		guint x = bx * GST_SPINNAKER_GATE_BLOCK;
+		guint end = MIN (x + GST_SPINNAKER_GATE_BLOCK, gate->width);
+		guint32 sum = 0;
+
+#ifdef __SSE2__
+		{
+			__m128i acc = _mm_setzero_si128 ();
+
+			for (; x + 16 <= end; x += 16)
+				acc = _mm_add_epi64 (acc, _mm_sad_epu8 (_mm_loadu_si128 ((const __m128i *) (row + x)),
+						_mm_loadu_si128 ((const __m128i *) (ref + x))));
+			sum = (guint32) (_mm_cvtsi128_si32 (acc) + _mm_cvtsi128_si32 (_mm_srli_si128 (acc, 8)));
+		}
+#endif
+		for (; x < end; x++)
+			sum += ABS ((gint) row[x] - (gint) ref[x]);
+		sad[bx] += sum;
+	}
+}
+
+gdouble
+gst_spinnaker_gate_change (GstSpinnakerGate * gate)
+{
+	gdouble change = 0.0;
+	guint bx, by;
+
+	if (!gate->has_ref)
+		return G_MAXDOUBLE;
+
+	for (by = 0; by < gate->blocks_y; by++) {
+		guint rows = MIN (GST_SPINNAKER_GATE_BLOCK, gate->height - by * GST_SPINNAKER_GATE_BLOCK);
+		guint sampled = (rows + GST_SPINNAKER_GATE_ROW_STEP - 1) / GST_SPINNAKER_GATE_ROW_STEP;
+		guint32 *sad = gate->sad + (gsize) by * gate->blocks_x;
+
+		for (bx = 0; bx < gate->blocks_x; bx++) {
+			guint cols = MIN (GST_SPINNAKER_GATE_BLOCK, gate->width - bx * GST_SPINNAKER_GATE_BLOCK);
+
+			change = MAX (change, (gdouble) sad[bx] / (cols * sampled));
+			sad[bx] = 0;
+		}
+	}
+	return change;
+}
+
+void
+gst_spinnaker_gate_accept (GstSpinnakerGate * gate)
+{
+	guint8 *ref = gate->ref;
+
+	gate->ref = gate->next;
+	gate->next = ref;
+	gate->has_ref = TRUE;
+}
@@ -0,0 +1,71 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_GATE_H_
+#define _GST_SPINNAKER_GATE_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GST_SPINNAKER_GATE_OFF,     // every frame is pushed
+  GST_SPINNAKER_GATE_DROP,    // unchanged frames are not pushed
+  GST_SPINNAKER_GATE_GAP      // unchanged frames are pushed flagged GAP
+} GstSpinnakerGateMode;
+
+#define GST_TYPE_SPINNAKER_GATE_MODE (gst_spinnaker_gate_mode_get_type ())
+GType gst_spinnaker_gate_mode_get_type (void);
+
+// Frames are compared in blocks of this many bytes by rows, on every
+// GST_SPINNAKER_GATE_ROW_STEP-th row
+#define GST_SPINNAKER_GATE_BLOCK 64
+#define GST_SPINNAKER_GATE_ROW_STEP 4
+
+// Finds whether any part of a frame changed since the last one accepted.
+// Rows are added by bands in any order, as long as a band doesn't share a
+// block of rows with another.
+typedef struct
+{
+  guint width;                // bytes per row
+  guint height;
+  guint blocks_x, blocks_y;
+  guint32 *sad;               // sum of absolute differences per block
+  guint8 *ref;                // sampled rows of the last accepted frame
+  guint8 *next;               // sampled rows of the current frame
+  gboolean has_ref;
+} GstSpinnakerGate;
+
+void gst_spinnaker_gate_init (GstSpinnakerGate * gate, guint width, guint height);
+void gst_spinnaker_gate_clear (GstSpinnakerGate * gate);
+
+// Compares row y of the current frame, if it is sampled
+void gst_spinnaker_gate_row (GstSpinnakerGate * gate, const guint8 * row, guint y);
+
+// The largest mean absolute difference of a block, in grey levels, once
+// all rows are in. G_MAXDOUBLE if nothing was accepted yet.
+gdouble gst_spinnaker_gate_change (GstSpinnakerGate * gate);
+
+// Makes the current frame the one the next ones are compared against
+void gst_spinnaker_gate_accept (GstSpinnakerGate * gate);
+
+G_END_DECLS
+
+#endif
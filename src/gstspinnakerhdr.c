@@ -0,0 +1,147 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gstspinnakerhdr.h"
+
+guint
+gst_spinnaker_hdr_set_exposures (GstSpinnakerHdrMerge * merge, const gdouble * t, guint n_frames)
+{
+	guint i, shortest = 0;
+
+	merge->n_frames = MIN (n_frames, GST_SPINNAKER_HDR_MAX_FRAMES);
+	for (i = 1; i < merge->n_frames; i++)
+		if (t[i] < t[shortest])
+			shortest = i;
+	for (i = 0; i < merge->n_frames; i++)
+		merge->scale[i] = t[shortest] / t[i];
+	merge->shortest = shortest;
+
+	return shortest;
+}
+
+// Hat weight, never zero so a pixel clipped in every exposure still has a value
+static inline gfloat
+gst_spinnaker_hdr_weight (guint v, guint max)
+{
+	return (gfloat) (MIN (v, max - v) + 1);
+}
+
+static inline guint
+gst_spinnaker_hdr_input (const GstSpinnakerHdrMerge * merge, const guint8 * row, guint x)
+{
+	return merge->in_bits == 8 ? row[x] : ((const guint16 *) row)[x];
+}
+
+static inline guint16
+gst_spinnaker_hdr_pixel (const GstSpinnakerHdrMerge * merge, const guint8 ** rows, guint x,
+		guint max, gfloat full)
+{
+	gfloat num = 0.0f, den = 0.0f;
+	guint i;
+
+	if (gst_spinnaker_hdr_input (merge, rows[merge->shortest], x) >= max)
+		return 65535;
+
+	for (i = 0; i < merge->n_frames; i++) {
+		guint v = MIN (gst_spinnaker_hdr_input (merge, rows[i], x), max);
+		gfloat w = gst_spinnaker_hdr_weight (v, max);
+		num += w * v * merge->scale[i];
+		den += w;
+	}
+	return (guint16) MIN (num / den * full + 0.5f, 65535.0f);
+}
+
+void
+gst_spinnaker_hdr_merge_rows (const GstSpinnakerHdrMerge * merge, guint first_row, guint n_rows)
+{
+	const guint8 *rows[GST_SPINNAKER_HDR_MAX_FRAMES];
+	guint max = (1u << merge->in_bits) - 1;
+	gfloat full = 65535.0f / max;
+	guint y, x, i;
+
+	for (y = first_row; y < first_row + n_rows && y < merge->height; y++) {
+		guint16 *out = (guint16 *) (merge->out + y * merge->out_stride);
+
+		for (i = 0; i < merge->n_frames; i++)
+			rows[i] = merge->planes[i] + y * merge->in_stride;
+		x = 0;
+
+#ifdef __SSE2__
+		{
+			const __m128i zero = _mm_setzero_si128 ();
+			const __m128i max16 = _mm_set1_epi16 ((gint16) max);
+			const __m128i bias16 = _mm_set1_epi16 ((gint16) 0x8000);
+			const __m128i bias32 = _mm_set1_epi32 (32768);
+			const __m128 cmax = _mm_set1_ps ((gfloat) max);
+			const __m128 cfull = _mm_set1_ps (full);
+			const __m128 one = _mm_set1_ps (1.0f);
+
+			// eight pixels at a time, as two vectors of four floats
+			for (; x + 8 <= merge->width; x += 8) {
+				__m128 num_lo = _mm_setzero_ps (), num_hi = _mm_setzero_ps ();
+				__m128 den_lo = _mm_setzero_ps (), den_hi = _mm_setzero_ps ();
+				__m128i clipped = zero, lo32, hi32, packed;
+
+				for (i = 0; i < merge->n_frames; i++) {
+					__m128i p16;
+					__m128 lo, hi, w_lo, w_hi, s;
+
+					if (merge->in_bits == 8)
+						p16 = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (rows[i] + x)), zero);
+					else
+						p16 = _mm_loadu_si128 ((const __m128i *) ((const guint16 *) rows[i] + x));
+					// unsigned minimum, through the signed one
+					p16 = _mm_xor_si128 (_mm_min_epi16 (_mm_xor_si128 (p16, bias16),
+							_mm_xor_si128 (max16, bias16)), bias16);
+					lo = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (p16, zero));
+					hi = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (p16, zero));
+					w_lo = _mm_add_ps (_mm_min_ps (lo, _mm_sub_ps (cmax, lo)), one);
+					w_hi = _mm_add_ps (_mm_min_ps (hi, _mm_sub_ps (cmax, hi)), one);
+					s = _mm_set1_ps (merge->scale[i]);
+
+					num_lo = _mm_add_ps (num_lo, _mm_mul_ps (_mm_mul_ps (w_lo, lo), s));
+					num_hi = _mm_add_ps (num_hi, _mm_mul_ps (_mm_mul_ps (w_hi, hi), s));
+					den_lo = _mm_add_ps (den_lo, w_lo);
+					den_hi = _mm_add_ps (den_hi, w_hi);
+					if (i == merge->shortest)
+						clipped = _mm_cmpeq_epi16 (p16, max16);
+				}
+
+				// no unsigned 32 -> 16 bit pack in SSE2, go through the signed one
+				lo32 = _mm_sub_epi32 (_mm_cvtps_epi32 (_mm_mul_ps (_mm_div_ps (num_lo, den_lo), cfull)), bias32);
+				hi32 = _mm_sub_epi32 (_mm_cvtps_epi32 (_mm_mul_ps (_mm_div_ps (num_hi, den_hi), cfull)), bias32);
+				packed = _mm_add_epi16 (_mm_packs_epi32 (lo32, hi32), bias16);
+				// SSE2 means x86, so these are already little endian
+				_mm_storeu_si128 ((__m128i *) (out + x), _mm_or_si128 (packed, clipped));
+			}
+		}
+#endif
+
+		for (; x < merge->width; x++)
+			out[x] = GUINT16_TO_LE (gst_spinnaker_hdr_pixel (merge, rows, x, max, full));
+	}
+}
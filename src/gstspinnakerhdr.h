@@ -0,0 +1,59 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_HDR_H_
+#define _GST_SPINNAKER_HDR_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GST_SPINNAKER_HDR_MAX_FRAMES 8
+
+// One bracket of exposures, at the sensor's depth, to be fused into a 16
+// bit frame
+typedef struct
+{
+  guint n_frames;
+  const guint8 *planes[GST_SPINNAKER_HDR_MAX_FRAMES];  // GRAY8, or 16 bit containers holding in_bits bits
+  guint in_stride;
+  guint in_bits;            // 8 .. 16
+  // brings a pixel of each exposure to the shortest one's, t_shortest / t_i
+  gfloat scale[GST_SPINNAKER_HDR_MAX_FRAMES];
+  guint shortest;           // exposure whose clipped pixels clip the output
+  guint8 *out;              // GRAY16_LE
+  guint out_stride;
+  guint width;
+  guint height;
+} GstSpinnakerHdrMerge;
+
+// Computes the scale factors for exposure times t (any unit), returns the
+// index of the shortest exposure
+guint gst_spinnaker_hdr_set_exposures (GstSpinnakerHdrMerge * merge,
+    const gdouble * t, guint n_frames);
+
+// Fuses rows [first_row, first_row + n_rows) of the bracket. Each output
+// pixel is the average of the exposures' radiance estimates, weighted by
+// how far the value is from either end of the in_bits range.
+void gst_spinnaker_hdr_merge_rows (const GstSpinnakerHdrMerge * merge,
+    guint first_row, guint n_rows);
+
+G_END_DECLS
+
+#endif
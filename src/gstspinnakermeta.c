@@ -0,0 +1,92 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/video/video.h>
+
+#include "gstspinnakermeta.h"
+
+GType
+gst_spinnaker_stats_meta_api_get_type (void)
+{
+	static GType type;
+	// the statistics describe the pixels, drop them when size or colours change
+	static const gchar *tags[] = { GST_META_TAG_VIDEO_STR, GST_META_TAG_VIDEO_SIZE_STR,
+		GST_META_TAG_VIDEO_COLORSPACE_STR, NULL };
+
+	if (g_once_init_enter (&type)) {
+		GType _type = gst_meta_api_type_register ("GstSpinnakerStatsMetaAPI", tags);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+static gboolean
+gst_spinnaker_stats_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+	GstSpinnakerStatsMeta *smeta = (GstSpinnakerStatsMeta *) meta;
+
+	memset (smeta->histogram, 0, sizeof (smeta->histogram));
+	smeta->n_pixels = 0;
+	smeta->min = 0;
+	smeta->max = 0;
+	smeta->mean = 0.0;
+	smeta->saturated = 0;
+	smeta->focus = -1.0;
+
+	return TRUE;
+}
+
+static gboolean
+gst_spinnaker_stats_meta_transform (GstBuffer * dest, GstMeta * meta,
+		GstBuffer * buffer, GQuark type, gpointer data)
+{
+	GstSpinnakerStatsMeta *smeta = (GstSpinnakerStatsMeta *) meta;
+	GstSpinnakerStatsMeta *dmeta;
+
+	// only plain copies keep the pixels the statistics were taken from
+	if (!GST_META_TRANSFORM_IS_COPY (type) || ((GstMetaTransformCopy *) data)->region)
+		return FALSE;
+
+	dmeta = gst_buffer_add_spinnaker_stats_meta (dest);
+	if (!dmeta)
+		return FALSE;
+
+	memcpy ((guint8 *) dmeta + sizeof (GstMeta), (guint8 *) smeta + sizeof (GstMeta),
+			sizeof (GstSpinnakerStatsMeta) - sizeof (GstMeta));
+	return TRUE;
+}
+
+const GstMetaInfo *
+gst_spinnaker_stats_meta_get_info (void)
+{
+	static const GstMetaInfo *meta_info = NULL;
+
+	if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+		const GstMetaInfo *mi = gst_meta_register (GST_SPINNAKER_STATS_META_API_TYPE,
+				"GstSpinnakerStatsMeta", sizeof (GstSpinnakerStatsMeta),
+				gst_spinnaker_stats_meta_init, NULL, gst_spinnaker_stats_meta_transform);
+		g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+	}
+	return meta_info;
+}
@@ -0,0 +1,70 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_META_H_
+#define _GST_SPINNAKER_META_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_SPINNAKER_STATS_META_API_TYPE (gst_spinnaker_stats_meta_api_get_type())
+#define GST_SPINNAKER_STATS_META_INFO  (gst_spinnaker_stats_meta_get_info())
+
+typedef struct _GstSpinnakerStatsMeta GstSpinnakerStatsMeta;
+
+/**
+ * GstSpinnakerStatsMeta:
+ * @meta: parent #GstMeta
+ * @histogram: 256 bin histogram of the 8 bit image
+ * @n_pixels: number of pixels counted
+ * @min: darkest pixel value
+ * @max: brightest pixel value
+ * @mean: mean pixel value
+ * @saturated: number of pixels at full scale
+ * @focus: mean gradient energy (dx^2 + dy^2) per pixel, or -1 if not computed
+ *
+ * Image statistics computed by spinnakersrc while it copies the frame.
+ * The meta is private to this plugin: the header isn't installed and the
+ * layout isn't versioned.
+ */
+struct _GstSpinnakerStatsMeta
+{
+  GstMeta meta;
+
+  guint32 histogram[256];
+  guint64 n_pixels;
+  guint8 min;
+  guint8 max;
+  gdouble mean;
+  guint64 saturated;
+  gdouble focus;
+};
+
+GType gst_spinnaker_stats_meta_api_get_type (void);
+const GstMetaInfo *gst_spinnaker_stats_meta_get_info (void);
+
+#define gst_buffer_get_spinnaker_stats_meta(b) \
+    ((GstSpinnakerStatsMeta *) gst_buffer_get_meta ((b), GST_SPINNAKER_STATS_META_API_TYPE))
+#define gst_buffer_add_spinnaker_stats_meta(b) \
+    ((GstSpinnakerStatsMeta *) gst_buffer_add_meta ((b), GST_SPINNAKER_STATS_META_INFO, NULL))
+
+G_END_DECLS
+
+#endif
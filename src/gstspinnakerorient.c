@@ -0,0 +1,138 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gstspinnakerorient.h"
+
+// columns of a transposition tile, its rows are the rows being written
+#define TILE_WIDTH 64
+
+GType
+gst_spinnaker_rotation_get_type (void)
+{
+	static GType type;
+	static const GEnumValue values[] = {
+		{GST_SPINNAKER_ROTATION_NONE, "No rotation", "none"},
+		{GST_SPINNAKER_ROTATION_90, "Rotate 90 degrees clockwise", "90"},
+		{GST_SPINNAKER_ROTATION_180, "Rotate 180 degrees", "180"},
+		{GST_SPINNAKER_ROTATION_270, "Rotate 90 degrees counterclockwise", "270"},
+		{0, NULL, NULL}
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstSpinnakerRotation", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+void
+gst_spinnaker_orientation_init (GstSpinnakerOrientation * o, gboolean hflip, gboolean vflip,
+		GstSpinnakerRotation rotation)
+{
+	// 180 reverses both axes, 90 is a transposition of the image turned
+	// upside down, 270 one of the image mirrored
+	o->reverse_x = !!hflip ^ (rotation == GST_SPINNAKER_ROTATION_180 || rotation == GST_SPINNAKER_ROTATION_270);
+	o->reverse_y = !!vflip ^ (rotation == GST_SPINNAKER_ROTATION_180 || rotation == GST_SPINNAKER_ROTATION_90);
+	o->transpose = rotation == GST_SPINNAKER_ROTATION_90 || rotation == GST_SPINNAKER_ROTATION_270;
+}
+
+static void
+gst_spinnaker_orient_reverse_row (const guint8 * in, guint8 * out, guint width, guint pstride)
+{
+	guint x = 0;
+
+	if (pstride == 1) {
+#ifdef __SSE2__
+		// reverse 16 bytes: swap the bytes of each word, then the words
+		for (; x + 16 <= width; x += 16) {
+			__m128i v = _mm_loadu_si128 ((const __m128i *) (in + width - x - 16));
+			v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+			v = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (v, 0x1b), 0x1b);
+			_mm_storeu_si128 ((__m128i *) (out + x), _mm_shuffle_epi32 (v, 0x4e));
+		}
+#endif
+		for (; x < width; x++)
+			out[x] = in[width - 1 - x];
+	} else {
+		const guint16 *in16 = (const guint16 *) in;
+		guint16 *out16 = (guint16 *) out;
+#ifdef __SSE2__
+		for (; x + 8 <= width; x += 8) {
+			__m128i v = _mm_loadu_si128 ((const __m128i *) (in16 + width - x - 8));
+			v = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (v, 0x1b), 0x1b);
+			_mm_storeu_si128 ((__m128i *) (out16 + x), _mm_shuffle_epi32 (v, 0x4e));
+		}
+#endif
+		for (; x < width; x++)
+			out16[x] = in16[width - 1 - x];
+	}
+}
+
+void
+gst_spinnaker_orient_rows (const GstSpinnakerOrientation * o, const guint8 * in, guint in_stride,
+		guint width, guint height, guint pstride, guint first_row, guint n_rows,
+		guint8 * out, guint out_stride)
+{
+	guint y, x, tx, last = MIN (first_row + n_rows, height);
+
+	if (!o->transpose) {
+		for (y = first_row; y < last; y++) {
+			const guint8 *row = in + y * in_stride;
+			guint8 *dst = out + (o->reverse_y ? height - 1 - y : y) * out_stride;
+
+			if (o->reverse_x)
+				gst_spinnaker_orient_reverse_row (row, dst, width, pstride);
+			else
+				memcpy (dst, row, width * pstride);
+		}
+		return;
+	}
+
+	// input column x becomes output row x', input row y output column y'
+	for (tx = 0; tx < width; tx += TILE_WIDTH) {
+		guint tile_end = MIN (tx + TILE_WIDTH, width);
+
+		for (y = first_row; y < last; y++) {
+			const guint8 *row = in + y * in_stride;
+			guint oy = o->reverse_y ? height - 1 - y : y;
+
+			if (pstride == 1) {
+				for (x = tx; x < tile_end; x++) {
+					guint ox = o->reverse_x ? width - 1 - x : x;
+					out[ox * out_stride + oy] = row[x];
+				}
+			} else {
+				for (x = tx; x < tile_end; x++) {
+					guint ox = o->reverse_x ? width - 1 - x : x;
+					((guint16 *) (out + ox * out_stride))[oy] = ((const guint16 *) row)[x];
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_ORIENT_H_
+#define _GST_SPINNAKER_ORIENT_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+// Clockwise rotation applied after hflip / vflip
+typedef enum
+{
+  GST_SPINNAKER_ROTATION_NONE,
+  GST_SPINNAKER_ROTATION_90,
+  GST_SPINNAKER_ROTATION_180,
+  GST_SPINNAKER_ROTATION_270
+} GstSpinnakerRotation;
+
+#define GST_TYPE_SPINNAKER_ROTATION (gst_spinnaker_rotation_get_type ())
+GType gst_spinnaker_rotation_get_type (void);
+
+// Every flip and rotation is a reversal of either axis followed by an
+// optional transposition
+typedef struct
+{
+  gboolean reverse_x;
+  gboolean reverse_y;
+  gboolean transpose;
+} GstSpinnakerOrientation;
+
+void gst_spinnaker_orientation_init (GstSpinnakerOrientation * o,
+    gboolean hflip, gboolean vflip, GstSpinnakerRotation rotation);
+
+// Writes rows [first_row, first_row + n_rows) of a width x height image of
+// pstride (1 or 2) byte pixels to their place in the oriented output.
+// Transposition goes through small tiles so reads and writes stay in cache.
+void gst_spinnaker_orient_rows (const GstSpinnakerOrientation * o,
+    const guint8 * in, guint in_stride, guint width, guint height, guint pstride,
+    guint first_row, guint n_rows, guint8 * out, guint out_stride);
+
+G_END_DECLS
+
+#endif
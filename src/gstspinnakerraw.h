@@ -0,0 +1,78 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/* On-disk layout shared by spinnakerrawsink and spinnakerrawsrc.
+ *
+ * A recording is two files. The data file starts with one
+ * GstSpinnakerRawHeader block, followed by the frames back to back, each
+ * padded to GST_SPINNAKER_RAW_ALIGN so it can be written with O_DIRECT.
+ * The index file (data file name + ".idx") is a GstSpinnakerRawIndexHeader
+ * followed by one GstSpinnakerRawIndexEntry per frame. All fields are in
+ * host byte order.
+ */
+
+#ifndef _GST_SPINNAKER_RAW_H_
+#define _GST_SPINNAKER_RAW_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_SPINNAKER_RAW_MAGIC         "SPNKRAW1"
+#define GST_SPINNAKER_RAW_INDEX_MAGIC   "SPNKIDX1"
+#define GST_SPINNAKER_RAW_VERSION       1
+#define GST_SPINNAKER_RAW_ALIGN         4096
+#define GST_SPINNAKER_RAW_INDEX_SUFFIX  ".idx"
+
+// caps of the GstReferenceTimestampMeta carrying the camera clock
+#define GST_SPINNAKER_HW_TIMESTAMP_CAPS "timestamp/x-spinnaker"
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 header_size;
+  gchar caps[GST_SPINNAKER_RAW_ALIGN - 16];  // NUL terminated caps string
+} GstSpinnakerRawHeader;
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 entry_size;
+} GstSpinnakerRawIndexHeader;
+
+// flags of an index entry
+#define GST_SPINNAKER_RAW_FLAG_DISCONT  (1 << 0)
+#define GST_SPINNAKER_RAW_FLAG_GAP      (1 << 1)
+
+typedef struct
+{
+  guint64 frame_id;       // buffer offset set by spinnakersrc
+  guint64 hw_timestamp;   // camera clock in ns, GST_CLOCK_TIME_NONE if unknown
+  guint64 pts;
+  guint64 duration;
+  guint64 offset;         // position of the frame in the data file
+  guint32 size;           // frame size without padding
+  guint32 flags;
+} GstSpinnakerRawIndexEntry;
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,648 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-spinnakerrawsink
+ *
+ * Records raw video frames straight to disk, bypassing muxers and the page
+ * cache. Frames are written with O_DIRECT from an asynchronous writer thread
+ * (using io_uring when the plugin was built with liburing), and a compact
+ * index of frame id, hardware timestamp and PTS is written next to the data.
+ * Play recordings back with spinnakerrawsrc.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 spinnakersrc ! queue ! spinnakerrawsink location=/data/run1.raw
+ * ]|
+ * </refsect2>
+ */
+
+// O_DIRECT
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+
+#include "gstspinnakerrawsink.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_spinnaker_raw_sink_debug);
+#define GST_CAT_DEFAULT gst_spinnaker_raw_sink_debug
+
+/* prototypes */
+static void gst_spinnaker_raw_sink_set_property (GObject * object,
+		guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_spinnaker_raw_sink_get_property (GObject * object,
+		guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_spinnaker_raw_sink_finalize (GObject * object);
+
+static gboolean gst_spinnaker_raw_sink_start (GstBaseSink * sink);
+static gboolean gst_spinnaker_raw_sink_stop (GstBaseSink * sink);
+static gboolean gst_spinnaker_raw_sink_set_caps (GstBaseSink * sink, GstCaps * caps);
+static gboolean gst_spinnaker_raw_sink_propose_allocation (GstBaseSink * sink, GstQuery * query);
+static GstFlowReturn gst_spinnaker_raw_sink_render (GstBaseSink * sink, GstBuffer * buffer);
+
+enum
+{
+	PROP_0,
+	PROP_LOCATION,
+	PROP_DIRECT_IO,
+	PROP_QUEUE_SIZE
+};
+
+#define DEFAULT_PROP_LOCATION    NULL
+#define DEFAULT_PROP_DIRECT_IO   TRUE
+#define DEFAULT_PROP_QUEUE_SIZE  16
+
+#define RAW_ALIGN                GST_SPINNAKER_RAW_ALIGN
+#define RAW_ALIGN_UP(n)          (((n) + RAW_ALIGN - 1) & ~((guint64) RAW_ALIGN - 1))
+#define RAW_ALIGN_DOWN(n)        ((n) & ~((guint64) RAW_ALIGN - 1))
+
+static GstStaticPadTemplate gst_spinnaker_raw_sink_template =
+		GST_STATIC_PAD_TEMPLATE ("sink",
+				GST_PAD_SINK,
+				GST_PAD_ALWAYS,
+				GST_STATIC_CAPS ("video/x-raw")
+		);
+
+G_DEFINE_TYPE_WITH_CODE (GstSpinnakerRawSink, gst_spinnaker_raw_sink, GST_TYPE_BASE_SINK,
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "spinnakerrawsink", 0,
+        "debug category for spinnakerrawsink element"));
+
+static void
+gst_spinnaker_raw_sink_class_init (GstSpinnakerRawSinkClass * klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+	GstBaseSinkClass *gstbasesink_class = GST_BASE_SINK_CLASS (klass);
+
+	gobject_class->set_property = gst_spinnaker_raw_sink_set_property;
+	gobject_class->get_property = gst_spinnaker_raw_sink_get_property;
+	gobject_class->finalize = gst_spinnaker_raw_sink_finalize;
+
+	gst_element_class_add_pad_template (gstelement_class,
+			gst_static_pad_template_get (&gst_spinnaker_raw_sink_template));
+
+	gst_element_class_set_static_metadata (gstelement_class,
+			"Spinnaker Raw Recorder", "Sink/File/Video",
+			"Writes raw frames and a frame index to disk with direct I/O", "David Thompson <dave@republicofdave.net>");
+
+	gstbasesink_class->start = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_sink_start);
+	gstbasesink_class->stop = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_sink_stop);
+	gstbasesink_class->set_caps = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_sink_set_caps);
+	gstbasesink_class->propose_allocation = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_sink_propose_allocation);
+	gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_sink_render);
+
+	g_object_class_install_property (gobject_class, PROP_LOCATION,
+		g_param_spec_string("location", "Location",
+			"Data file to write, the index goes to the same name with \"" GST_SPINNAKER_RAW_INDEX_SUFFIX "\" appended.",
+			DEFAULT_PROP_LOCATION,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_DIRECT_IO,
+		g_param_spec_boolean("direct-io", "Direct I/O",
+			"Open the data file with O_DIRECT, bypassing the page cache. Falls back to buffered I/O if the filesystem refuses.",
+			DEFAULT_PROP_DIRECT_IO,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+	g_object_class_install_property (gobject_class, PROP_QUEUE_SIZE,
+		g_param_spec_uint("queue-size", "Queue size",
+			"Frames that may be queued for (or in flight to) the disk before render() blocks.",
+			1, 1024, DEFAULT_PROP_QUEUE_SIZE,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+}
+
+static void
+gst_spinnaker_raw_sink_init (GstSpinnakerRawSink * sink)
+{
+	sink->location = DEFAULT_PROP_LOCATION;
+	sink->direct_io = DEFAULT_PROP_DIRECT_IO;
+	sink->queue_size = DEFAULT_PROP_QUEUE_SIZE;
+	sink->fd = -1;
+	sink->index_fd = -1;
+
+	g_mutex_init (&sink->lock);
+	g_cond_init (&sink->cond);
+
+	// recording must not be throttled to the clock
+	gst_base_sink_set_sync (GST_BASE_SINK (sink), FALSE);
+}
+
+static void
+gst_spinnaker_raw_sink_set_property (GObject * object, guint property_id,
+		const GValue * value, GParamSpec * pspec)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (object);
+
+	switch (property_id) {
+	case PROP_LOCATION:
+		g_free (sink->location);
+		sink->location = g_value_dup_string (value);
+		break;
+	case PROP_DIRECT_IO:
+		sink->direct_io = g_value_get_boolean (value);
+		break;
+	case PROP_QUEUE_SIZE:
+		sink->queue_size = g_value_get_uint (value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+		break;
+	}
+}
+
+static void
+gst_spinnaker_raw_sink_get_property (GObject * object, guint property_id,
+		GValue * value, GParamSpec * pspec)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (object);
+
+	switch (property_id) {
+	case PROP_LOCATION:
+		g_value_set_string (value, sink->location);
+		break;
+	case PROP_DIRECT_IO:
+		g_value_set_boolean (value, sink->direct_io);
+		break;
+	case PROP_QUEUE_SIZE:
+		g_value_set_uint (value, sink->queue_size);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+		break;
+	}
+}
+
+static void
+gst_spinnaker_raw_sink_finalize (GObject * object)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (object);
+
+	g_free (sink->location);
+	g_mutex_clear (&sink->lock);
+	g_cond_clear (&sink->cond);
+
+	G_OBJECT_CLASS (gst_spinnaker_raw_sink_parent_class)->finalize (object);
+}
+
+// pwrite() until everything is written
+static gboolean
+gst_spinnaker_raw_sink_pwrite (gint fd, const guint8 * data, gsize len, guint64 offset)
+{
+	while (len > 0) {
+		ssize_t n = pwrite (fd, data, len, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		data += n;
+		len -= n;
+		offset += n;
+	}
+	return TRUE;
+}
+
+#ifdef HAVE_LIBURING
+// Submits all writes of a batch at once and waits for them, so the device
+// sees queue-size requests in flight instead of one at a time
+static gboolean
+gst_spinnaker_raw_sink_write_uring (GstSpinnakerRawSink * sink, guint first, guint n)
+{
+	struct io_uring_cqe *cqe;
+	guint i, submitted = 0;
+	gboolean ok = TRUE;
+
+	for (i = 0; i < n; i++) {
+		GstSpinnakerRawJob *job = &sink->jobs[(first + i) % sink->queue_size];
+		struct io_uring_sqe *sqe;
+
+		if (job->direct_len) {
+			sqe = io_uring_get_sqe (&sink->ring);
+			io_uring_prep_write (sqe, sink->fd, job->direct, job->direct_len, job->offset);
+			io_uring_sqe_set_data (sqe, GSIZE_TO_POINTER (job->direct_len));
+			submitted++;
+		}
+		if (job->staging_len) {
+			sqe = io_uring_get_sqe (&sink->ring);
+			io_uring_prep_write (sqe, sink->fd, job->staging, job->staging_len,
+					job->offset + job->direct_len);
+			io_uring_sqe_set_data (sqe, GSIZE_TO_POINTER (job->staging_len));
+			submitted++;
+		}
+	}
+
+	if (io_uring_submit_and_wait (&sink->ring, submitted) < 0)
+		return FALSE;
+
+	for (i = 0; i < submitted; i++) {
+		if (io_uring_wait_cqe (&sink->ring, &cqe) < 0)
+			return FALSE;
+		// a short write leaves a hole in the recording, treat it as an error
+		if (cqe->res < 0 || (gsize) cqe->res != GPOINTER_TO_SIZE (io_uring_cqe_get_data (cqe)))
+			ok = FALSE;
+		io_uring_cqe_seen (&sink->ring, cqe);
+	}
+	return ok;
+}
+#endif
+
+static gboolean
+gst_spinnaker_raw_sink_write_batch (GstSpinnakerRawSink * sink, guint first, guint n)
+{
+	guint i;
+
+#ifdef HAVE_LIBURING
+	if (sink->have_ring)
+		return gst_spinnaker_raw_sink_write_uring (sink, first, n);
+#endif
+
+	for (i = 0; i < n; i++) {
+		GstSpinnakerRawJob *job = &sink->jobs[(first + i) % sink->queue_size];
+
+		if (job->direct_len &&
+				!gst_spinnaker_raw_sink_pwrite (sink->fd, job->direct, job->direct_len, job->offset))
+			return FALSE;
+		if (job->staging_len &&
+				!gst_spinnaker_raw_sink_pwrite (sink->fd, job->staging, job->staging_len,
+					job->offset + job->direct_len))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// Writes whatever render() queued, in batches, and appends the index
+// entries once their frames are on disk
+static gpointer
+gst_spinnaker_raw_sink_writer (gpointer data)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (data);
+	guint first, n, i;
+
+	g_mutex_lock (&sink->lock);
+	for (;;) {
+		while (sink->count == 0 && !sink->stopping)
+			g_cond_wait (&sink->cond, &sink->lock);
+		if (sink->count == 0)
+			break;
+
+		// render() only touches slots past head + count, so the batch can be
+		// written without holding the lock
+		first = sink->head;
+		n = sink->count;
+		g_mutex_unlock (&sink->lock);
+
+		if (!sink->write_failed && !gst_spinnaker_raw_sink_write_batch (sink, first, n)) {
+			GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, ("Error writing to %s", sink->location),
+					("%s", g_strerror (errno)));
+			sink->write_failed = TRUE;
+		}
+
+		for (i = 0; i < n; i++) {
+			GstSpinnakerRawJob *job = &sink->jobs[(first + i) % sink->queue_size];
+
+			sink->index_batch[i] = job->entry;
+			if (job->buffer) {
+				gst_buffer_unmap (job->buffer, &job->map);
+				gst_buffer_unref (job->buffer);
+				job->buffer = NULL;
+			}
+		}
+		if (!sink->write_failed &&
+				!gst_spinnaker_raw_sink_pwrite (sink->index_fd, (const guint8 *) sink->index_batch,
+					n * sizeof (GstSpinnakerRawIndexEntry),
+					sizeof (GstSpinnakerRawIndexHeader) + sink->frames_written * sizeof (GstSpinnakerRawIndexEntry))) {
+			GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, ("Error writing the index of %s", sink->location),
+					("%s", g_strerror (errno)));
+			sink->write_failed = TRUE;
+		}
+		sink->frames_written += n;
+
+		g_mutex_lock (&sink->lock);
+		sink->head = (sink->head + n) % sink->queue_size;
+		sink->count -= n;
+		g_cond_broadcast (&sink->cond);
+	}
+	g_mutex_unlock (&sink->lock);
+
+	return NULL;
+}
+
+static gboolean
+gst_spinnaker_raw_sink_start (GstBaseSink * bsink)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (bsink);
+	GstSpinnakerRawIndexHeader index_header;
+	gchar *index_location;
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+	GST_DEBUG_OBJECT (sink, "start");
+
+	if (sink->location == NULL) {
+		GST_ELEMENT_ERROR (sink, RESOURCE, NOT_FOUND, ("No file name specified for writing."), (NULL));
+		return FALSE;
+	}
+
+	sink->using_direct = FALSE;
+	if (sink->direct_io) {
+		sink->fd = open (sink->location, flags | O_DIRECT, 0644);
+		if (sink->fd >= 0)
+			sink->using_direct = TRUE;
+		else if (errno == EINVAL)
+			GST_WARNING_OBJECT (sink, "%s does not support O_DIRECT, using buffered I/O", sink->location);
+	}
+	if (sink->fd < 0)
+		sink->fd = open (sink->location, flags, 0644);
+	if (sink->fd < 0) {
+		GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, ("Could not open %s for writing.", sink->location),
+				("%s", g_strerror (errno)));
+		return FALSE;
+	}
+
+	index_location = g_strconcat (sink->location, GST_SPINNAKER_RAW_INDEX_SUFFIX, NULL);
+	sink->index_fd = open (index_location, flags, 0644);
+	if (sink->index_fd < 0) {
+		GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, ("Could not open %s for writing.", index_location),
+				("%s", g_strerror (errno)));
+		g_free (index_location);
+		goto fail;
+	}
+	g_free (index_location);
+
+	memset (&index_header, 0, sizeof (index_header));
+	memcpy (index_header.magic, GST_SPINNAKER_RAW_INDEX_MAGIC, sizeof (index_header.magic));
+	index_header.version = GST_SPINNAKER_RAW_VERSION;
+	index_header.entry_size = sizeof (GstSpinnakerRawIndexEntry);
+	if (!gst_spinnaker_raw_sink_pwrite (sink->index_fd, (const guint8 *) &index_header, sizeof (index_header), 0)) {
+		GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, ("Error writing the index header."), ("%s", g_strerror (errno)));
+		goto fail;
+	}
+
+	// the header block is written along with the first frame, once the caps are known
+	sink->write_offset = RAW_ALIGN;
+	sink->frames_written = 0;
+	sink->head = 0;
+	sink->count = 0;
+	sink->stopping = FALSE;
+	sink->write_failed = FALSE;
+	sink->jobs = g_new0 (GstSpinnakerRawJob, sink->queue_size);
+	sink->index_batch = g_new0 (GstSpinnakerRawIndexEntry, sink->queue_size);
+
+#ifdef HAVE_LIBURING
+	sink->have_ring = io_uring_queue_init (2 * sink->queue_size, &sink->ring, 0) == 0;
+	if (!sink->have_ring)
+		GST_WARNING_OBJECT (sink, "io_uring is not available, writing with pwrite()");
+#endif
+
+	sink->writer = g_thread_new ("spinnakerrawsink", gst_spinnaker_raw_sink_writer, sink);
+
+	GST_INFO_OBJECT (sink, "recording to %s (%s)", sink->location,
+			sink->using_direct ? "direct I/O" : "buffered I/O");
+	return TRUE;
+
+	fail:
+	if (sink->index_fd >= 0)
+		close (sink->index_fd);
+	close (sink->fd);
+	sink->index_fd = -1;
+	sink->fd = -1;
+	return FALSE;
+}
+
+static gboolean
+gst_spinnaker_raw_sink_stop (GstBaseSink * bsink)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (bsink);
+	guint i;
+
+	GST_DEBUG_OBJECT (sink, "stop");
+
+	if (sink->writer) {
+		g_mutex_lock (&sink->lock);
+		sink->stopping = TRUE;
+		g_cond_broadcast (&sink->cond);
+		g_mutex_unlock (&sink->lock);
+		g_thread_join (sink->writer);
+		sink->writer = NULL;
+	}
+
+#ifdef HAVE_LIBURING
+	if (sink->have_ring)
+		io_uring_queue_exit (&sink->ring);
+	sink->have_ring = FALSE;
+#endif
+
+	if (sink->jobs) {
+		for (i = 0; i < sink->queue_size; i++)
+			free (sink->jobs[i].staging);
+		g_free (sink->jobs);
+		sink->jobs = NULL;
+	}
+	g_free (sink->index_batch);
+	sink->index_batch = NULL;
+
+	if (sink->fd >= 0) {
+		fsync (sink->fd);
+		close (sink->fd);
+	}
+	if (sink->index_fd >= 0)
+		close (sink->index_fd);
+	sink->fd = -1;
+	sink->index_fd = -1;
+
+	g_free (sink->caps_string);
+	sink->caps_string = NULL;
+
+	GST_INFO_OBJECT (sink, "wrote %" G_GUINT64_FORMAT " frames", sink->frames_written);
+	return TRUE;
+}
+
+static gboolean
+gst_spinnaker_raw_sink_set_caps (GstBaseSink * bsink, GstCaps * caps)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (bsink);
+	gchar *caps_string = gst_caps_to_string (caps);
+
+	// a recording has a single format, written in the header
+	if (sink->caps_string && strcmp (sink->caps_string, caps_string) != 0) {
+		GST_ERROR_OBJECT (sink, "caps changed during recording: %s", caps_string);
+		g_free (caps_string);
+		return FALSE;
+	}
+	if (strlen (caps_string) >= sizeof (((GstSpinnakerRawHeader *) NULL)->caps)) {
+		GST_ERROR_OBJECT (sink, "caps too long for the recording header");
+		g_free (caps_string);
+		return FALSE;
+	}
+
+	g_free (sink->caps_string);
+	sink->caps_string = caps_string;
+	return TRUE;
+}
+
+// Ask upstream for block aligned memory, so frames can go to disk without a copy
+static gboolean
+gst_spinnaker_raw_sink_propose_allocation (GstBaseSink * bsink, GstQuery * query)
+{
+	GstAllocationParams params;
+
+	gst_allocation_params_init (&params);
+	params.align = RAW_ALIGN - 1;
+	gst_query_add_allocation_param (query, NULL, &params);
+
+	return TRUE;
+}
+
+static gboolean
+gst_spinnaker_raw_sink_ensure_staging (GstSpinnakerRawJob * job, gsize size)
+{
+	if (job->staging_cap >= size)
+		return TRUE;
+
+	free (job->staging);
+	job->staging = NULL;
+	job->staging_cap = 0;
+	if (posix_memalign ((void **) &job->staging, RAW_ALIGN, size) != 0)
+		return FALSE;
+	job->staging_cap = size;
+	return TRUE;
+}
+
+// Queues one frame for the writer thread. The block aligned part of an
+// aligned buffer is written from the buffer itself; only the remainder is
+// copied into the job's staging block.
+static GstFlowReturn
+gst_spinnaker_raw_sink_render (GstBaseSink * bsink, GstBuffer * buffer)
+{
+	GstSpinnakerRawSink *sink = GST_SPINNAKER_RAW_SINK (bsink);
+	GstSpinnakerRawJob *job;
+	GstReferenceTimestampMeta *tmeta;
+	GstCaps *ts_caps;
+	gsize size, tail, header_len = 0;
+	guint8 *dest;
+
+	g_mutex_lock (&sink->lock);
+	while (sink->count == sink->queue_size && !sink->write_failed)
+		g_cond_wait (&sink->cond, &sink->lock);
+	job = &sink->jobs[(sink->head + sink->count) % sink->queue_size];
+	g_mutex_unlock (&sink->lock);
+	if (sink->write_failed)
+		return GST_FLOW_ERROR;
+
+	job->buffer = gst_buffer_ref (buffer);
+	if (!gst_buffer_map (job->buffer, &job->map, GST_MAP_READ)) {
+		gst_buffer_unref (job->buffer);
+		job->buffer = NULL;
+		GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, ("Unable to map buffer"), (NULL));
+		return GST_FLOW_ERROR;
+	}
+	size = job->map.size;
+
+	// the first job also carries the header block
+	if (sink->write_offset == RAW_ALIGN)
+		header_len = RAW_ALIGN;
+
+	job->direct = NULL;
+	job->direct_len = 0;
+	if (!sink->using_direct) {
+		job->direct = job->map.data;
+		job->direct_len = size;
+	} else if (((guintptr) job->map.data & (RAW_ALIGN - 1)) == 0) {
+		job->direct = job->map.data;
+		job->direct_len = RAW_ALIGN_DOWN (size);
+	}
+	tail = size - job->direct_len;
+	job->staging_len = RAW_ALIGN_UP (size) - job->direct_len;
+
+	// the header is written in front of the frame, so the frame can't go direct
+	if (header_len) {
+		job->direct = NULL;
+		job->direct_len = 0;
+		tail = size;
+		job->staging_len = header_len + RAW_ALIGN_UP (size);
+	}
+
+	if (!gst_spinnaker_raw_sink_ensure_staging (job, job->staging_len)) {
+		gst_buffer_unmap (job->buffer, &job->map);
+		gst_buffer_unref (job->buffer);
+		job->buffer = NULL;
+		GST_ELEMENT_ERROR (sink, RESOURCE, NO_SPACE_LEFT, ("Out of memory for staging buffers"), (NULL));
+		return GST_FLOW_ERROR;
+	}
+
+	dest = job->staging;
+	if (header_len) {
+		GstSpinnakerRawHeader *header = (GstSpinnakerRawHeader *) dest;
+
+		memset (header, 0, sizeof (*header));
+		memcpy (header->magic, GST_SPINNAKER_RAW_MAGIC, sizeof (header->magic));
+		header->version = GST_SPINNAKER_RAW_VERSION;
+		header->header_size = RAW_ALIGN;
+		if (sink->caps_string)
+			g_strlcpy (header->caps, sink->caps_string, sizeof (header->caps));
+		dest += header_len;
+	}
+	if (job->staging_len > header_len) {
+		memcpy (dest, job->map.data + job->direct_len, tail);
+		memset (dest + tail, 0, job->staging_len - header_len - tail);
+	}
+
+	job->offset = sink->write_offset - header_len;
+	sink->write_offset += job->direct_len + job->staging_len - header_len;
+
+	job->entry.frame_id = GST_BUFFER_OFFSET (buffer);
+	job->entry.pts = GST_BUFFER_PTS (buffer);
+	job->entry.duration = GST_BUFFER_DURATION (buffer);
+	job->entry.offset = job->offset + header_len;
+	job->entry.size = size;
+	job->entry.flags = 0;
+	if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT))
+		job->entry.flags |= GST_SPINNAKER_RAW_FLAG_DISCONT;
+	if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_GAP))
+		job->entry.flags |= GST_SPINNAKER_RAW_FLAG_GAP;
+	job->entry.hw_timestamp = GST_CLOCK_TIME_NONE;
+	ts_caps = gst_caps_new_empty_simple (GST_SPINNAKER_HW_TIMESTAMP_CAPS);
+	tmeta = gst_buffer_get_reference_timestamp_meta (buffer, ts_caps);
+	if (tmeta)
+		job->entry.hw_timestamp = tmeta->timestamp;
+	gst_caps_unref (ts_caps);
+
+	// fully staged frames don't need to hold on to upstream's memory
+	if (job->direct_len == 0) {
+		gst_buffer_unmap (job->buffer, &job->map);
+		gst_buffer_unref (job->buffer);
+		job->buffer = NULL;
+	}
+
+	g_mutex_lock (&sink->lock);
+	sink->count++;
+	g_cond_broadcast (&sink->cond);
+	g_mutex_unlock (&sink->lock);
+
+	return GST_FLOW_OK;
+}
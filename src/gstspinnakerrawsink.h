@@ -0,0 +1,98 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_RAW_SINK_H_
+#define _GST_SPINNAKER_RAW_SINK_H_
+
+#include <gst/base/gstbasesink.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "gstspinnakerraw.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SPINNAKER_RAW_SINK   (gst_spinnaker_raw_sink_get_type())
+#define GST_SPINNAKER_RAW_SINK(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SPINNAKER_RAW_SINK,GstSpinnakerRawSink))
+#define GST_SPINNAKER_RAW_SINK_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_SPINNAKER_RAW_SINK,GstSpinnakerRawSinkClass))
+#define GST_IS_SPINNAKER_RAW_SINK(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SPINNAKER_RAW_SINK))
+
+typedef struct _GstSpinnakerRawSink GstSpinnakerRawSink;
+typedef struct _GstSpinnakerRawSinkClass GstSpinnakerRawSinkClass;
+
+// One frame on its way to disk
+typedef struct
+{
+  GstBuffer *buffer;        // kept mapped while its memory is written directly
+  GstMapInfo map;
+  const guint8 *direct;     // block aligned part written straight from the buffer
+  gsize direct_len;
+  guint8 *staging;          // aligned copy of the rest, zero padded to a block
+  gsize staging_len;
+  gsize staging_cap;
+  guint64 offset;
+  GstSpinnakerRawIndexEntry entry;
+} GstSpinnakerRawJob;
+
+struct _GstSpinnakerRawSink
+{
+  GstBaseSink base_raw_sink;
+
+  // properties
+  gchar *location;
+  gboolean direct_io;
+  guint queue_size;
+
+  // files
+  gint fd;
+  gint index_fd;
+  gboolean using_direct;
+  guint64 write_offset;
+  gchar *caps_string;
+
+  // writer thread, jobs [head, head + count) are queued or being written
+  GstSpinnakerRawJob *jobs;
+  GstSpinnakerRawIndexEntry *index_batch;
+  guint head;
+  guint count;
+  GMutex lock;
+  GCond cond;
+  GThread *writer;
+  gboolean stopping;
+  gboolean write_failed;
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+  gboolean have_ring;
+#endif
+
+  guint64 frames_written;
+};
+
+struct _GstSpinnakerRawSinkClass
+{
+  GstBaseSinkClass base_raw_sink_class;
+};
+
+GType gst_spinnaker_raw_sink_get_type (void);
+
+G_END_DECLS
+
+#endif
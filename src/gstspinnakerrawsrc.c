@@ -0,0 +1,335 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-spinnakerrawsrc
+ *
+ * Plays back a recording made by spinnakerrawsink. The data file is
+ * memory mapped and frames are pushed without copying, with the recorded
+ * frame id as buffer offset and the camera timestamp as a
+ * #GstReferenceTimestampMeta.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 spinnakerrawsrc location=/data/run1.raw ! videoconvert ! autovideosink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+#include "gstspinnakerrawsrc.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_spinnaker_raw_src_debug);
+#define GST_CAT_DEFAULT gst_spinnaker_raw_src_debug
+
+/* prototypes */
+static void gst_spinnaker_raw_src_set_property (GObject * object,
+		guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_spinnaker_raw_src_get_property (GObject * object,
+		guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_spinnaker_raw_src_finalize (GObject * object);
+
+static gboolean gst_spinnaker_raw_src_start (GstBaseSrc * src);
+static gboolean gst_spinnaker_raw_src_stop (GstBaseSrc * src);
+static GstCaps *gst_spinnaker_raw_src_get_caps (GstBaseSrc * src, GstCaps * filter);
+static GstFlowReturn gst_spinnaker_raw_src_create (GstPushSrc * src, GstBuffer ** buf);
+
+enum
+{
+	PROP_0,
+	PROP_LOCATION
+};
+
+#define DEFAULT_PROP_LOCATION NULL
+
+static GstStaticPadTemplate gst_spinnaker_raw_src_template =
+		GST_STATIC_PAD_TEMPLATE ("src",
+				GST_PAD_SRC,
+				GST_PAD_ALWAYS,
+				GST_STATIC_CAPS ("video/x-raw")
+		);
+
+G_DEFINE_TYPE_WITH_CODE (GstSpinnakerRawSrc, gst_spinnaker_raw_src, GST_TYPE_PUSH_SRC,
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "spinnakerrawsrc", 0,
+        "debug category for spinnakerrawsrc element"));
+
+static void
+gst_spinnaker_raw_src_class_init (GstSpinnakerRawSrcClass * klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+	GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
+	GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+
+	gobject_class->set_property = gst_spinnaker_raw_src_set_property;
+	gobject_class->get_property = gst_spinnaker_raw_src_get_property;
+	gobject_class->finalize = gst_spinnaker_raw_src_finalize;
+
+	gst_element_class_add_pad_template (gstelement_class,
+			gst_static_pad_template_get (&gst_spinnaker_raw_src_template));
+
+	gst_element_class_set_static_metadata (gstelement_class,
+			"Spinnaker Raw Player", "Source/File/Video",
+			"Plays back recordings made by spinnakerrawsink", "David Thompson <dave@republicofdave.net>");
+
+	gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_src_start);
+	gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_src_stop);
+	gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_src_get_caps);
+
+	gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_spinnaker_raw_src_create);
+
+	g_object_class_install_property (gobject_class, PROP_LOCATION,
+		g_param_spec_string("location", "Location",
+			"Data file of the recording, the index is read from the same name with \"" GST_SPINNAKER_RAW_INDEX_SUFFIX "\" appended.",
+			DEFAULT_PROP_LOCATION,
+			(GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+}
+
+static void
+gst_spinnaker_raw_src_init (GstSpinnakerRawSrc * src)
+{
+	src->location = DEFAULT_PROP_LOCATION;
+
+	gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
+}
+
+static void
+gst_spinnaker_raw_src_set_property (GObject * object, guint property_id,
+		const GValue * value, GParamSpec * pspec)
+{
+	GstSpinnakerRawSrc *src = GST_SPINNAKER_RAW_SRC (object);
+
+	switch (property_id) {
+	case PROP_LOCATION:
+		g_free (src->location);
+		src->location = g_value_dup_string (value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+		break;
+	}
+}
+
+static void
+gst_spinnaker_raw_src_get_property (GObject * object, guint property_id,
+		GValue * value, GParamSpec * pspec)
+{
+	GstSpinnakerRawSrc *src = GST_SPINNAKER_RAW_SRC (object);
+
+	switch (property_id) {
+	case PROP_LOCATION:
+		g_value_set_string (value, src->location);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+		break;
+	}
+}
+
+static void
+gst_spinnaker_raw_src_finalize (GObject * object)
+{
+	GstSpinnakerRawSrc *src = GST_SPINNAKER_RAW_SRC (object);
+
+	g_free (src->location);
+
+	G_OBJECT_CLASS (gst_spinnaker_raw_src_parent_class)->finalize (object);
+}
+
+static GMappedFile *
+gst_spinnaker_raw_src_map (GstSpinnakerRawSrc * src, const gchar * location)
+{
+	GError *err = NULL;
+	GMappedFile *file = g_mapped_file_new (location, FALSE, &err);
+
+	if (file == NULL) {
+		GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, ("Could not open %s for reading.", location),
+				("%s", err->message));
+		g_error_free (err);
+		return NULL;
+	}
+
+	// playback reads front to back, let the kernel read ahead aggressively
+	if (g_mapped_file_get_length (file) > 0)
+		madvise (g_mapped_file_get_contents (file), g_mapped_file_get_length (file), MADV_SEQUENTIAL);
+
+	return file;
+}
+
+static gboolean
+gst_spinnaker_raw_src_start (GstBaseSrc * bsrc)
+{
+	GstSpinnakerRawSrc *src = GST_SPINNAKER_RAW_SRC (bsrc);
+	const GstSpinnakerRawHeader *header;
+	const GstSpinnakerRawIndexHeader *index_header;
+	gchar *index_location;
+	gsize data_len, index_len;
+	guint64 i;
+
+	GST_DEBUG_OBJECT (src, "start");
+
+	if (src->location == NULL) {
+		GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND, ("No file name specified for reading."), (NULL));
+		return FALSE;
+	}
+
+	src->data = gst_spinnaker_raw_src_map (src, src->location);
+	if (src->data == NULL)
+		return FALSE;
+	index_location = g_strconcat (src->location, GST_SPINNAKER_RAW_INDEX_SUFFIX, NULL);
+	src->index = gst_spinnaker_raw_src_map (src, index_location);
+	g_free (index_location);
+	if (src->index == NULL)
+		goto fail;
+
+	data_len = g_mapped_file_get_length (src->data);
+	index_len = g_mapped_file_get_length (src->index);
+	header = (const GstSpinnakerRawHeader *) g_mapped_file_get_contents (src->data);
+	index_header = (const GstSpinnakerRawIndexHeader *) g_mapped_file_get_contents (src->index);
+
+	if (data_len < sizeof (GstSpinnakerRawHeader) || index_len < sizeof (GstSpinnakerRawIndexHeader) ||
+			memcmp (header->magic, GST_SPINNAKER_RAW_MAGIC, sizeof (header->magic)) != 0 ||
+			memcmp (index_header->magic, GST_SPINNAKER_RAW_INDEX_MAGIC, sizeof (index_header->magic)) != 0) {
+		GST_ELEMENT_ERROR (src, STREAM, WRONG_TYPE, ("%s is not a spinnakerrawsink recording.", src->location), (NULL));
+		goto fail;
+	}
+	if (header->version != GST_SPINNAKER_RAW_VERSION || index_header->version != GST_SPINNAKER_RAW_VERSION ||
+			index_header->entry_size != sizeof (GstSpinnakerRawIndexEntry)) {
+		GST_ELEMENT_ERROR (src, STREAM, FORMAT, ("Unsupported recording version %u.", header->version), (NULL));
+		goto fail;
+	}
+
+	src->caps = gst_caps_from_string (header->caps);
+	if (src->caps == NULL || !gst_caps_is_fixed (src->caps)) {
+		GST_ELEMENT_ERROR (src, STREAM, FORMAT, ("Invalid caps in recording header: %s", header->caps), (NULL));
+		goto fail;
+	}
+
+	src->entries = (const GstSpinnakerRawIndexEntry *) (index_header + 1);
+	src->n_frames = (index_len - sizeof (GstSpinnakerRawIndexHeader)) / sizeof (GstSpinnakerRawIndexEntry);
+
+	// a recording cut short by a crash may index frames that never made it to disk
+	for (i = 0; i < src->n_frames; i++) {
+		if (src->entries[i].offset + src->entries[i].size > data_len)
+			break;
+	}
+	if (i < src->n_frames)
+		GST_WARNING_OBJECT (src, "recording is truncated, playing %" G_GUINT64_FORMAT " of %"
+				G_GUINT64_FORMAT " frames", i, src->n_frames);
+	src->n_frames = i;
+
+	src->next_frame = 0;
+	src->pts_base = src->n_frames ? src->entries[0].pts : GST_CLOCK_TIME_NONE;
+
+	GST_INFO_OBJECT (src, "%" G_GUINT64_FORMAT " frames of %" GST_PTR_FORMAT, src->n_frames, src->caps);
+	return TRUE;
+
+	fail:
+	gst_spinnaker_raw_src_stop (bsrc);
+	return FALSE;
+}
+
+static gboolean
+gst_spinnaker_raw_src_stop (GstBaseSrc * bsrc)
+{
+	GstSpinnakerRawSrc *src = GST_SPINNAKER_RAW_SRC (bsrc);
+
+	GST_DEBUG_OBJECT (src, "stop");
+
+	// buffers still downstream hold their own reference on the data mapping
+	if (src->data)
+		g_mapped_file_unref (src->data);
+	if (src->index)
+		g_mapped_file_unref (src->index);
+	src->data = NULL;
+	src->index = NULL;
+	src->entries = NULL;
+	src->n_frames = 0;
+	gst_caps_replace (&src->caps, NULL);
+
+	return TRUE;
+}
+
+static GstCaps *
+gst_spinnaker_raw_src_get_caps (GstBaseSrc * bsrc, GstCaps * filter)
+{
+	GstSpinnakerRawSrc *src = GST_SPINNAKER_RAW_SRC (bsrc);
+	GstCaps *caps;
+
+	if (src->caps == NULL)
+		caps = gst_pad_get_pad_template_caps (GST_BASE_SRC_PAD (src));
+	else
+		caps = gst_caps_ref (src->caps);
+
+	if (filter) {
+		GstCaps *tmp = gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+		gst_caps_unref (caps);
+		caps = tmp;
+	}
+
+	return caps;
+}
+
+static GstFlowReturn
+gst_spinnaker_raw_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+{
+	GstSpinnakerRawSrc *src = GST_SPINNAKER_RAW_SRC (psrc);
+	const GstSpinnakerRawIndexEntry *entry;
+	GstBuffer *buffer;
+
+	if (src->next_frame >= src->n_frames) {
+		GST_DEBUG_OBJECT (src, "end of recording");
+		return GST_FLOW_EOS;
+	}
+	entry = &src->entries[src->next_frame++];
+
+	// wrap the mapping, it stays alive until the last buffer is freed
+	buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+			g_mapped_file_get_contents (src->data) + entry->offset, entry->size,
+			0, entry->size, g_mapped_file_ref (src->data), (GDestroyNotify) g_mapped_file_unref);
+
+	GST_BUFFER_OFFSET (buffer) = entry->frame_id;
+	GST_BUFFER_OFFSET_END (buffer) = entry->frame_id + 1;
+	GST_BUFFER_DURATION (buffer) = entry->duration;
+	if (GST_CLOCK_TIME_IS_VALID (entry->pts) && GST_CLOCK_TIME_IS_VALID (src->pts_base) &&
+			entry->pts >= src->pts_base)
+		GST_BUFFER_PTS (buffer) = entry->pts - src->pts_base;
+	if (entry->flags & GST_SPINNAKER_RAW_FLAG_DISCONT)
+		GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+	if (entry->flags & GST_SPINNAKER_RAW_FLAG_GAP)
+		GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_GAP);
+
+	if (GST_CLOCK_TIME_IS_VALID (entry->hw_timestamp)) {
+		GstCaps *ts_caps = gst_caps_new_empty_simple (GST_SPINNAKER_HW_TIMESTAMP_CAPS);
+		gst_buffer_add_reference_timestamp_meta (buffer, ts_caps, entry->hw_timestamp, GST_CLOCK_TIME_NONE);
+		gst_caps_unref (ts_caps);
+	}
+
+	*buf = buffer;
+	return GST_FLOW_OK;
+}
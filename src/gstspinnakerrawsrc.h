@@ -0,0 +1,64 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_RAW_SRC_H_
+#define _GST_SPINNAKER_RAW_SRC_H_
+
+#include <gst/base/gstpushsrc.h>
+
+#include "gstspinnakerraw.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SPINNAKER_RAW_SRC   (gst_spinnaker_raw_src_get_type())
+#define GST_SPINNAKER_RAW_SRC(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SPINNAKER_RAW_SRC,GstSpinnakerRawSrc))
+#define GST_SPINNAKER_RAW_SRC_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_SPINNAKER_RAW_SRC,GstSpinnakerRawSrcClass))
+#define GST_IS_SPINNAKER_RAW_SRC(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SPINNAKER_RAW_SRC))
+
+typedef struct _GstSpinnakerRawSrc GstSpinnakerRawSrc;
+typedef struct _GstSpinnakerRawSrcClass GstSpinnakerRawSrcClass;
+
+struct _GstSpinnakerRawSrc
+{
+  GstPushSrc base_raw_src;
+
+  // properties
+  gchar *location;
+
+  // mapped recording
+  GMappedFile *data;
+  GMappedFile *index;
+  const GstSpinnakerRawIndexEntry *entries;
+  guint64 n_frames;
+  GstCaps *caps;
+
+  guint64 next_frame;
+  GstClockTime pts_base;
+};
+
+struct _GstSpinnakerRawSrcClass
+{
+  GstPushSrcClass base_raw_src_class;
+};
+
+GType gst_spinnaker_raw_src_get_type (void);
+
+G_END_DECLS
+
+#endif
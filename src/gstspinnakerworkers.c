@@ -0,0 +1,314 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+// pthread_setaffinity_np
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "gstspinnakerworkers.h"
+
+typedef struct
+{
+	GstSpinnakerWorkers *workers;
+	gint cpu;                 // -1 when not pinned
+} GstSpinnakerWorkerSlot;
+
+struct _GstSpinnakerThreadState
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	cpu_set_t cpus;
+	gboolean have_cpus;
+#endif
+	int policy;               // -1 if unknown
+	struct sched_param param;
+};
+
+struct _GstSpinnakerWorkers
+{
+	GThread **threads;
+	GstSpinnakerWorkerSlot *slots;
+	guint n_threads;          // including the caller
+	GstSpinnakerThreadConfig config;  // without the CPU list, which is in the slots
+	guint starting;           // threads still setting themselves up
+	gboolean set_up;          // every thread runs as asked
+
+	GMutex lock;
+	GCond work_cond;          // a new batch is available, or quit
+	GCond done_cond;          // the last job of a batch finished
+	guint generation;         // bumped for every batch
+	gboolean quit;
+
+	// current batch
+	GstSpinnakerWorkFunc func;
+	gpointer user_data;
+	guint n_jobs;
+	guint next_job;
+	guint pending;            // jobs not finished yet
+};
+
+GType
+gst_spinnaker_scheduling_get_type (void)
+{
+	static GType type;
+	static const GEnumValue values[] = {
+		{GST_SPINNAKER_SCHEDULING_NORMAL, "The system's default time sharing", "normal"},
+		{GST_SPINNAKER_SCHEDULING_FIFO, "Real-time, first in first out (SCHED_FIFO)", "fifo"},
+		{GST_SPINNAKER_SCHEDULING_RR, "Real-time, round robin (SCHED_RR)", "rr"},
+		{0, NULL, NULL}
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstSpinnakerScheduling", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+gboolean
+gst_spinnaker_thread_setup (const GstSpinnakerThreadConfig * config, gint cpu)
+{
+	gboolean ok = TRUE;
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	if (cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO (&set);
+		CPU_SET (cpu, &set);
+		if (pthread_setaffinity_np (pthread_self (), sizeof (set), &set) != 0)
+			ok = FALSE;
+	}
+#else
+	if (cpu >= 0)
+		ok = FALSE;
+#endif
+
+	// real-time priorities need CAP_SYS_NICE or an rtprio limit, without
+	// them the thread stays time shared
+	if (config->scheduling != GST_SPINNAKER_SCHEDULING_NORMAL) {
+		int policy = config->scheduling == GST_SPINNAKER_SCHEDULING_FIFO ? SCHED_FIFO : SCHED_RR;
+		struct sched_param param = { 0, };
+
+		param.sched_priority = CLAMP (config->priority, sched_get_priority_min (policy),
+				sched_get_priority_max (policy));
+		if (pthread_setschedparam (pthread_self (), policy, &param) != 0)
+			ok = FALSE;
+	}
+
+	return ok;
+}
+
+GstSpinnakerThreadState *
+gst_spinnaker_thread_save (void)
+{
+	GstSpinnakerThreadState *state = g_new0 (GstSpinnakerThreadState, 1);
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	state->have_cpus = pthread_getaffinity_np (pthread_self (), sizeof (state->cpus), &state->cpus) == 0;
+#endif
+	if (pthread_getschedparam (pthread_self (), &state->policy, &state->param) != 0)
+		state->policy = -1;
+	return state;
+}
+
+void
+gst_spinnaker_thread_restore (GstSpinnakerThreadState * state)
+{
+	if (state == NULL)
+		return;
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	if (state->have_cpus)
+		pthread_setaffinity_np (pthread_self (), sizeof (state->cpus), &state->cpus);
+#endif
+	if (state->policy >= 0)
+		pthread_setschedparam (pthread_self (), state->policy, &state->param);
+	g_free (state);
+}
+
+// Takes jobs of the current batch until there are none left. Called with
+// the lock held, returns with it held.
+static void
+gst_spinnaker_workers_drain (GstSpinnakerWorkers * workers)
+{
+	while (workers->next_job < workers->n_jobs) {
+		guint job = workers->next_job++;
+		GstSpinnakerWorkFunc func = workers->func;
+		gpointer user_data = workers->user_data;
+		guint n_jobs = workers->n_jobs;
+
+		g_mutex_unlock (&workers->lock);
+		func (job, n_jobs, user_data);
+		g_mutex_lock (&workers->lock);
+
+		if (--workers->pending == 0)
+			g_cond_signal (&workers->done_cond);
+	}
+}
+
+static gpointer
+gst_spinnaker_workers_thread (gpointer data)
+{
+	GstSpinnakerWorkerSlot *slot = data;
+	GstSpinnakerWorkers *workers = slot->workers;
+	guint seen = 0;
+	gboolean set_up = gst_spinnaker_thread_setup (&workers->config, slot->cpu);
+
+	g_mutex_lock (&workers->lock);
+	workers->set_up &= set_up;
+	if (--workers->starting == 0)
+		g_cond_signal (&workers->done_cond);
+	for (;;) {
+		while (workers->generation == seen && !workers->quit)
+			g_cond_wait (&workers->work_cond, &workers->lock);
+		if (workers->quit)
+			break;
+		seen = workers->generation;
+		gst_spinnaker_workers_drain (workers);
+	}
+	g_mutex_unlock (&workers->lock);
+
+	return NULL;
+}
+
+GstSpinnakerWorkers *
+gst_spinnaker_workers_new (guint n_threads, const GstSpinnakerThreadConfig * config)
+{
+	GstSpinnakerWorkers *workers = g_new0 (GstSpinnakerWorkers, 1);
+	gint *cpus = NULL;
+	guint n_cpus = 0;
+	guint i;
+
+	workers->n_threads = MAX (n_threads, 1);
+	workers->starting = workers->n_threads - 1;
+	workers->set_up = TRUE;
+	g_mutex_init (&workers->lock);
+	g_cond_init (&workers->work_cond);
+	g_cond_init (&workers->done_cond);
+	if (config) {
+		workers->config = *config;
+		workers->config.cpus = NULL;
+		workers->config.n_cpus = 0;
+	}
+
+	// only pinned to CPUs asked for
+	if (config && config->cpus) {
+		cpus = g_new (gint, config->n_cpus);
+		for (n_cpus = 0; n_cpus < config->n_cpus; n_cpus++)
+			cpus[n_cpus] = config->cpus[n_cpus];
+	}
+
+	workers->threads = g_new0 (GThread *, workers->n_threads);
+	workers->slots = g_new0 (GstSpinnakerWorkerSlot, workers->n_threads);
+	for (i = 1; i < workers->n_threads; i++) {
+		workers->slots[i].workers = workers;
+		// more threads than CPUs share them in turn, the caller's first one
+		// only when there is no other
+		if (n_cpus > 1)
+			workers->slots[i].cpu = cpus[1 + (i - 1) % (n_cpus - 1)];
+		else
+			workers->slots[i].cpu = n_cpus ? cpus[0] : -1;
+		workers->threads[i] = g_thread_new ("spinnakerworker", gst_spinnaker_workers_thread,
+				&workers->slots[i]);
+	}
+	g_free (cpus);
+
+	// so whether they could be set up is known when this returns
+	g_mutex_lock (&workers->lock);
+	while (workers->starting > 0)
+		g_cond_wait (&workers->done_cond, &workers->lock);
+	g_mutex_unlock (&workers->lock);
+
+	return workers;
+}
+
+void
+gst_spinnaker_workers_free (GstSpinnakerWorkers * workers)
+{
+	guint i;
+
+	if (workers == NULL)
+		return;
+
+	g_mutex_lock (&workers->lock);
+	workers->quit = TRUE;
+	g_cond_broadcast (&workers->work_cond);
+	g_mutex_unlock (&workers->lock);
+
+	for (i = 1; i < workers->n_threads; i++)
+		g_thread_join (workers->threads[i]);
+
+	g_free (workers->threads);
+	g_free (workers->slots);
+	g_mutex_clear (&workers->lock);
+	g_cond_clear (&workers->work_cond);
+	g_cond_clear (&workers->done_cond);
+	g_free (workers);
+}
+
+guint
+gst_spinnaker_workers_get_n_threads (GstSpinnakerWorkers * workers)
+{
+	return workers ? workers->n_threads : 1;
+}
+
+gboolean
+gst_spinnaker_workers_is_set_up (GstSpinnakerWorkers * workers)
+{
+	return workers == NULL || workers->set_up;
+}
+
+void
+gst_spinnaker_workers_run (GstSpinnakerWorkers * workers, guint n_jobs,
+		GstSpinnakerWorkFunc func, gpointer user_data)
+{
+	guint i;
+
+	if (n_jobs == 0)
+		return;
+
+	// nothing to share, skip the hand-off
+	if (workers == NULL || workers->n_threads == 1 || n_jobs == 1) {
+		for (i = 0; i < n_jobs; i++)
+			func (i, n_jobs, user_data);
+		return;
+	}
+
+	g_mutex_lock (&workers->lock);
+	workers->func = func;
+	workers->user_data = user_data;
+	workers->n_jobs = n_jobs;
+	workers->next_job = 0;
+	workers->pending = n_jobs;
+	workers->generation++;
+	g_cond_broadcast (&workers->work_cond);
+
+	gst_spinnaker_workers_drain (workers);
+	while (workers->pending > 0)
+		g_cond_wait (&workers->done_cond, &workers->lock);
+	g_mutex_unlock (&workers->lock);
+}
@@ -0,0 +1,81 @@
+/* GStreamer Spinnaker Plugin
+ * Copyright (C) 2019 Embry-Riddle Aeronautical University
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SPINNAKER_WORKERS_H_
+#define _GST_SPINNAKER_WORKERS_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstSpinnakerWorkers GstSpinnakerWorkers;
+
+typedef enum
+{
+  GST_SPINNAKER_SCHEDULING_NORMAL,
+  GST_SPINNAKER_SCHEDULING_FIFO,
+  GST_SPINNAKER_SCHEDULING_RR
+} GstSpinnakerScheduling;
+
+#define GST_TYPE_SPINNAKER_SCHEDULING (gst_spinnaker_scheduling_get_type ())
+GType gst_spinnaker_scheduling_get_type (void);
+
+// Where and how the streaming thread and the workers run
+typedef struct
+{
+  const gint *cpus;           // CPUs to run on, NULL for any the caller may use
+  guint n_cpus;
+  GstSpinnakerScheduling scheduling;
+  gint priority;              // for the real-time policies
+} GstSpinnakerThreadConfig;
+
+// Moves the calling thread to cpu, unless it is negative, and to config's
+// scheduling. Returns FALSE if either isn't permitted; the thread keeps
+// running as it was for that part.
+gboolean gst_spinnaker_thread_setup (const GstSpinnakerThreadConfig * config, gint cpu);
+
+// The calling thread's affinity and scheduling, to put back on the same
+// thread once it no longer works for us. Restoring frees the state.
+typedef struct _GstSpinnakerThreadState GstSpinnakerThreadState;
+GstSpinnakerThreadState *gst_spinnaker_thread_save (void);
+void gst_spinnaker_thread_restore (GstSpinnakerThreadState * state);
+
+// Runs one job; jobs of a call are numbered 0 .. n_jobs - 1
+typedef void (*GstSpinnakerWorkFunc) (guint job, guint n_jobs, gpointer user_data);
+
+// A small set of threads created once and reused for every frame, so the
+// per-frame cost is one wake-up instead of a thread start. The calling
+// thread takes part in the work, n_threads counts it too. With a config,
+// each thread runs with config's scheduling and, if config lists CPUs, is
+// bound to one of them, leaving the first one to the caller.
+GstSpinnakerWorkers *gst_spinnaker_workers_new (guint n_threads,
+    const GstSpinnakerThreadConfig * config);
+void gst_spinnaker_workers_free (GstSpinnakerWorkers * workers);
+guint gst_spinnaker_workers_get_n_threads (GstSpinnakerWorkers * workers);
+// FALSE if a thread couldn't be pinned or scheduled as asked; it then runs
+// as it was for that part
+gboolean gst_spinnaker_workers_is_set_up (GstSpinnakerWorkers * workers);
+
+// Runs func for every job and returns once all of them are done
+void gst_spinnaker_workers_run (GstSpinnakerWorkers * workers, guint n_jobs,
+    GstSpinnakerWorkFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif